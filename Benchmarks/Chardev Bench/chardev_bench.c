@@ -0,0 +1,605 @@
+// chardev_bench.c - load generator for simple_chardev and ioctl_dev
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <time.h>
+#include <sys/ioctl.h>
+#include <sys/eventfd.h>
+#include <linux/types.h>
+
+// simple_chardev interface (Day 1 Character Driver)
+#define CHARDEV_MAGIC 'c'
+
+struct chardev_rec_offsets {
+    __u32 max;
+    __u32 count;
+    __u64 offsets;
+};
+
+#define CHARDEV_SET_RECORD_MODE _IOW(CHARDEV_MAGIC, 1, int)
+#define CHARDEV_GET_RECORD_OFFSETS _IOWR(CHARDEV_MAGIC, 2, struct chardev_rec_offsets)
+
+// ioctl_dev interface (Day 2 ioctl)
+#define MAGIC_NUM 'k'
+#define IOCTL_GET_COUNTER _IOR(MAGIC_NUM, 1, int)
+#define IOCTL_SET_COUNTER _IOW(MAGIC_NUM, 2, int)
+#define IOCTL_RESET_COUNTER _IO(MAGIC_NUM, 3)
+#define IOCTL_INCREMENT _IO(MAGIC_NUM, 4)
+
+#define COUNTER_WATCH_VALUE (1 << 0)
+#define COUNTER_WATCH_DELTA (1 << 1)
+
+struct counter_watch {
+    __s32 value;
+    __u32 delta;
+    __s32 eventfd;
+    __u32 flags;
+};
+
+#define IOCTL_SET_WATCH _IOW(MAGIC_NUM, 5, struct counter_watch)
+#define IOCTL_CLEAR_WATCH _IO(MAGIC_NUM, 6)
+#define IOCTL_ACK_WATCH _IOR(MAGIC_NUM, 7, int)
+#define IOCTL_ADD_COUNTER _IOW(MAGIC_NUM, 8, int)
+
+#define MAX_SIZES 16
+#define MAX_KOPS 16
+#define DEFAULT_SIZES "64,1024,4096,65536"
+#define MAX_RECORD (65536 - 4)    // Record ring size minus the length header
+
+struct worker {
+    pthread_t thread;
+    const struct bench_op *op;
+    const char *path;
+    int fd;
+    int pipe[2];              // splice: device -> pipe -> /dev/null
+    int null_fd;
+    int efd;                  // eventfd for the watch ops
+    int index;
+    void *buf;
+    size_t size;
+    uint64_t ops;
+    int err;
+};
+
+struct bench_op {
+    const char *device;       // "chardev" or "ioctl"
+    const char *name;
+    const char *kname[2];     // Matching entries in the debugfs timing file
+    int sized;                // Run once per payload size
+    int prefill;              // Needs data in the byte buffer before the run
+    int (*setup)(struct worker *w);   // Optional, once per thread before the run
+    int (*fn)(struct worker *w);
+};
+
+struct bench_dev {
+    const char *name;
+    const char *path;
+    const char *timing;       // debugfs file with "<op> <count> <total_ns>" lines
+    const char *param;        // Module parameter that enables the kernel hooks
+};
+
+struct ktiming {
+    int n;
+    char name[MAX_KOPS][32];
+    uint64_t count[MAX_KOPS];
+    uint64_t ns[MAX_KOPS];
+};
+
+static struct bench_dev devices[] = {
+    { "chardev", "/dev/simple_chardev",
+      "/sys/kernel/debug/simple_chardev/timing",
+      "/sys/module/simple_chardev/parameters/timing" },
+    { "ioctl", "/dev/ioctl_dev",
+      "/sys/kernel/debug/ioctl_dev/timing",
+      "/sys/module/ioctl_chardev/parameters/timing" },
+};
+
+static volatile int stop;
+static pthread_mutex_t start_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t start_cond = PTHREAD_COND_INITIALIZER;
+static int started;
+
+static int op_open_close(struct worker *w) {
+    int fd = open(w->path, O_RDWR);
+
+    if (fd < 0)
+        return -1;
+    return close(fd);
+}
+
+static int op_read(struct worker *w) {
+    return pread(w->fd, w->buf, w->size, 0) < 0 ? -1 : 0;
+}
+
+static int op_write(struct worker *w) {
+    return write(w->fd, w->buf, w->size) < 0 ? -1 : 0;
+}
+
+// Splice the buffer into a pipe by page reference, then discard it
+static int op_splice(struct worker *w) {
+    loff_t off = 0;
+    ssize_t n = splice(w->fd, &off, w->pipe[1], NULL, w->size, 0);
+
+    if (n <= 0)
+        return -1;
+    return splice(w->pipe[0], NULL, w->null_fd, NULL, n, 0) < 0 ? -1 : 0;
+}
+
+static int setup_splice(struct worker *w) {
+    if (pipe(w->pipe) < 0)
+        return -1;
+    w->null_fd = open("/dev/null", O_WRONLY);
+    return w->null_fd < 0 ? -1 : 0;
+}
+
+/*
+ * One record in, one record out. Threads share the ring, so a write can
+ * find it full or a read can find another thread took the record; both
+ * are EAGAIN on the non-blocking fd and still count as an op. A head
+ * record bigger than the buffer (EMSGSIZE) is left for the setup drain of
+ * the next run rather than stopping the thread.
+ */
+static int op_record_rw(struct worker *w) {
+    size_t size = w->size < MAX_RECORD ? w->size : MAX_RECORD;
+
+    if (write(w->fd, w->buf, size) < 0 && errno != EAGAIN)
+        return -1;
+    if (read(w->fd, w->buf, size) < 0 && errno != EAGAIN && errno != EMSGSIZE)
+        return -1;
+    return 0;
+}
+
+// The ring outlives the run: drop what earlier sizes left queued in it
+static int setup_record_mode(struct worker *w) {
+    static char drain[MAX_RECORD];
+    int mode = 1;
+
+    if (fcntl(w->fd, F_SETFL, O_NONBLOCK) < 0 ||
+        ioctl(w->fd, CHARDEV_SET_RECORD_MODE, &mode) < 0)
+        return -1;
+    while (read(w->fd, drain, sizeof(drain)) > 0)
+        ;
+    return errno == EAGAIN ? 0 : -1;
+}
+
+static int op_set_record_mode(struct worker *w) {
+    int mode = 0;
+
+    return ioctl(w->fd, CHARDEV_SET_RECORD_MODE, &mode);
+}
+
+static int op_get_record_offsets(struct worker *w) {
+    struct chardev_rec_offsets req = { 0 };
+
+    return ioctl(w->fd, CHARDEV_GET_RECORD_OFFSETS, &req);
+}
+
+static int op_get_counter(struct worker *w) {
+    int value;
+
+    return ioctl(w->fd, IOCTL_GET_COUNTER, &value);
+}
+
+static int op_set_counter(struct worker *w) {
+    return ioctl(w->fd, IOCTL_SET_COUNTER, &w->index);
+}
+
+static int op_reset_counter(struct worker *w) {
+    return ioctl(w->fd, IOCTL_RESET_COUNTER);
+}
+
+static int op_increment(struct worker *w) {
+    return ioctl(w->fd, IOCTL_INCREMENT);
+}
+
+static int op_add_counter(struct worker *w) {
+    int n = 1;
+
+    return ioctl(w->fd, IOCTL_ADD_COUNTER, &n);
+}
+
+static int setup_eventfd(struct worker *w) {
+    w->efd = eventfd(0, EFD_NONBLOCK);
+    return w->efd < 0 ? -1 : 0;
+}
+
+// Re-register a value watch that never fires; takes and drops the eventfd
+static int op_set_watch(struct worker *w) {
+    struct counter_watch watch = {
+        .value = INT32_MAX,
+        .eventfd = w->efd,
+        .flags = COUNTER_WATCH_VALUE,
+    };
+
+    return ioctl(w->fd, IOCTL_SET_WATCH, &watch);
+}
+
+static int op_clear_watch(struct worker *w) {
+    return ioctl(w->fd, IOCTL_CLEAR_WATCH);
+}
+
+static int op_ack_watch(struct worker *w) {
+    int value;
+
+    return ioctl(w->fd, IOCTL_ACK_WATCH, &value);
+}
+
+// Every increment crosses this thread's threshold and signals its eventfd
+static int setup_delta_watch(struct worker *w) {
+    struct counter_watch watch = {
+        .delta = 1,
+        .flags = COUNTER_WATCH_DELTA,
+    };
+
+    if (setup_eventfd(w) < 0)
+        return -1;
+    watch.eventfd = w->efd;
+    return ioctl(w->fd, IOCTL_SET_WATCH, &watch);
+}
+
+static const struct bench_op ops[] = {
+    { "chardev", "open_close", { "open", "release" }, 0, 0, NULL, op_open_close },
+    { "chardev", "read", { "read" }, 1, 1, NULL, op_read },
+    { "chardev", "write", { "write" }, 1, 0, NULL, op_write },
+    { "chardev", "splice", { "splice_read" }, 1, 1, setup_splice, op_splice },
+    { "chardev", "record_rw", { "write", "read" }, 1, 0, setup_record_mode, op_record_rw },
+    { "chardev", "set_record_mode", { "set_record_mode" }, 0, 0, NULL, op_set_record_mode },
+    { "chardev", "get_record_offsets", { "get_record_offsets" }, 0, 0, NULL, op_get_record_offsets },
+    { "ioctl", "open_close", { "open", "release" }, 0, 0, NULL, op_open_close },
+    { "ioctl", "get_counter", { "get_counter" }, 0, 0, NULL, op_get_counter },
+    { "ioctl", "set_counter", { "set_counter" }, 0, 0, NULL, op_set_counter },
+    { "ioctl", "reset_counter", { "reset_counter" }, 0, 0, NULL, op_reset_counter },
+    { "ioctl", "increment", { "increment" }, 0, 0, NULL, op_increment },
+    { "ioctl", "add_counter", { "add_counter" }, 0, 0, NULL, op_add_counter },
+    { "ioctl", "increment_notify", { "increment" }, 0, 0, setup_delta_watch, op_increment },
+    { "ioctl", "set_watch", { "set_watch" }, 0, 0, setup_eventfd, op_set_watch },
+    { "ioctl", "clear_watch", { "clear_watch" }, 0, 0, NULL, op_clear_watch },
+    { "ioctl", "ack_watch", { "ack_watch" }, 0, 0, NULL, op_ack_watch },
+};
+
+static double now(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static int ktiming_read(const char *path, struct ktiming *kt) {
+    FILE *f = fopen(path, "r");
+    unsigned long long count, ns;
+    char name[32];
+
+    kt->n = 0;
+    if (!f)
+        return -1;
+    while (kt->n < MAX_KOPS &&
+           fscanf(f, "%31s %llu %llu", name, &count, &ns) == 3) {
+        strcpy(kt->name[kt->n], name);
+        kt->count[kt->n] = count;
+        kt->ns[kt->n] = ns;
+        kt->n++;
+    }
+    fclose(f);
+    return 0;
+}
+
+static void ktiming_get(const struct ktiming *kt, const char *name,
+                        uint64_t *count, uint64_t *ns) {
+    int i;
+
+    for (i = 0; i < kt->n; i++) {
+        if (!strcmp(kt->name[i], name)) {
+            *count += kt->count[i];
+            *ns += kt->ns[i];
+        }
+    }
+}
+
+// Kernel ns per call of the named hooks between two snapshots, or -1
+static double ktiming_delta(const struct ktiming *before,
+                            const struct ktiming *after,
+                            const struct bench_op *op) {
+    uint64_t c0 = 0, n0 = 0, c1 = 0, n1 = 0;
+    int i, hooks = 0;
+
+    for (i = 0; i < 2 && op->kname[i]; i++) {
+        ktiming_get(before, op->kname[i], &c0, &n0);
+        ktiming_get(after, op->kname[i], &c1, &n1);
+        hooks++;
+    }
+    if (c1 <= c0)
+        return -1;
+    // open_close spans two hooks, so report the cost of the pair
+    return (double)(n1 - n0) / (c1 - c0) * hooks;
+}
+
+static void *worker_fn(void *arg) {
+    struct worker *w = arg;
+
+    pthread_mutex_lock(&start_lock);
+    while (!started)
+        pthread_cond_wait(&start_cond, &start_lock);
+    pthread_mutex_unlock(&start_lock);
+    while (!stop) {
+        if (w->op->fn(w) < 0) {
+            w->err = errno;
+            break;
+        }
+        w->ops++;
+    }
+    return NULL;
+}
+
+static void print_result(int json, int *first, const struct bench_op *op,
+                         int threads, size_t size, uint64_t total,
+                         double secs, double kns) {
+    double ops_per_sec = total / secs;
+    double ns_per_op = total ? secs * 1e9 * threads / total : 0;
+
+    if (json) {
+        printf("%s\n  {\"device\": \"%s\", \"op\": \"%s\", \"threads\": %d, "
+               "\"size\": %zu, \"ops\": %llu, \"seconds\": %.6f, "
+               "\"ops_per_sec\": %.1f, \"ns_per_op\": %.1f, "
+               "\"kernel_ns_per_op\": ",
+               *first ? "" : ",", op->device, op->name, threads, size,
+               (unsigned long long)total, secs, ops_per_sec, ns_per_op);
+        if (kns < 0)
+            printf("null}");
+        else
+            printf("%.1f}", kns);
+    } else {
+        printf("%s,%s,%d,%zu,%llu,%.6f,%.1f,%.1f,",
+               op->device, op->name, threads, size,
+               (unsigned long long)total, secs, ops_per_sec, ns_per_op);
+        if (kns >= 0)
+            printf("%.1f", kns);
+        printf("\n");
+    }
+    *first = 0;
+    fflush(stdout);
+}
+
+static int run_one(const struct bench_op *op, const struct bench_dev *dev,
+                   int threads, size_t size, double duration, int kernel,
+                   int json, int *first) {
+    struct worker *w = calloc(threads, sizeof(*w));
+    struct ktiming before, after;
+    uint64_t total = 0;
+    double t0, secs, kns = -1;
+    int i, created, err, ret = 0;
+
+    if (!w)
+        return -1;
+
+    // Everything the cleanup path closes starts out closed
+    for (i = 0; i < threads; i++)
+        w[i].fd = w[i].pipe[0] = w[i].pipe[1] = w[i].null_fd = w[i].efd = -1;
+
+    for (i = 0; i < threads; i++) {
+        w[i].op = op;
+        w[i].path = dev->path;
+        w[i].index = i;
+        w[i].size = size;
+        w[i].buf = malloc(size ? size : 1);
+        if (!w[i].buf) {
+            ret = -1;
+            goto out;
+        }
+        memset(w[i].buf, 'a' + i % 26, size ? size : 1);
+        if (op->fn != op_open_close) {
+            w[i].fd = open(dev->path, O_RDWR);
+            if (w[i].fd < 0) {
+                fprintf(stderr, "%s: %s\n", dev->path, strerror(errno));
+                ret = -1;
+                goto out;
+            }
+        }
+        if (op->setup && op->setup(&w[i]) < 0) {
+            fprintf(stderr, "%s/%s: setup: %s\n", op->device, op->name,
+                    strerror(errno));
+            ret = -1;
+            goto out;
+        }
+    }
+
+    // Reads need data behind them: fill the buffer once
+    if (op->prefill && write(w[0].fd, w[0].buf, size) < 0) {
+        perror("prefill write");
+        ret = -1;
+        goto out;
+    }
+
+    stop = 0;
+    started = 0;
+    for (created = 0; created < threads; created++) {
+        err = pthread_create(&w[created].thread, NULL, worker_fn, &w[created]);
+        if (err)
+            break;
+    }
+    if (created < threads) {
+        // Release the threads that did start straight into a stopped run
+        fprintf(stderr, "%s/%s: pthread_create: %s\n", op->device, op->name,
+                strerror(err));
+        stop = 1;
+    }
+
+    if (kernel && !stop)
+        ktiming_read(dev->timing, &before);
+    pthread_mutex_lock(&start_lock);
+    started = 1;
+    pthread_cond_broadcast(&start_cond);
+    pthread_mutex_unlock(&start_lock);
+    if (stop) {
+        for (i = 0; i < created; i++)
+            pthread_join(w[i].thread, NULL);
+        ret = -1;
+        goto out;
+    }
+    t0 = now();
+    nanosleep(&(struct timespec){ .tv_sec = (time_t)duration,
+                  .tv_nsec = (long)((duration - (time_t)duration) * 1e9) }, NULL);
+    stop = 1;
+    for (i = 0; i < threads; i++)
+        pthread_join(w[i].thread, NULL);
+    secs = now() - t0;
+    if (kernel && !ktiming_read(dev->timing, &after))
+        kns = ktiming_delta(&before, &after, op);
+
+    for (i = 0; i < threads; i++) {
+        total += w[i].ops;
+        if (w[i].err)
+            fprintf(stderr, "%s/%s: thread %d stopped: %s\n",
+                    op->device, op->name, i, strerror(w[i].err));
+    }
+
+    print_result(json, first, op, threads, size, total, secs, kns);
+
+out:
+    for (i = 0; i < threads; i++) {
+        if (w[i].fd >= 0)
+            close(w[i].fd);
+        if (w[i].pipe[0] >= 0) {
+            close(w[i].pipe[0]);
+            close(w[i].pipe[1]);
+        }
+        if (w[i].null_fd >= 0)
+            close(w[i].null_fd);
+        if (w[i].efd >= 0)
+            close(w[i].efd);
+        free(w[i].buf);
+    }
+    free(w);
+    return ret;
+}
+
+// 1, 2, 4, ... with max_threads as the last step even if not a power of two
+static int next_threads(int t, int max_threads) {
+    if (t == max_threads)
+        return max_threads + 1;
+    return t * 2 < max_threads ? t * 2 : max_threads;
+}
+
+static int in_list(const char *list, const char *name) {
+    size_t len = strlen(name);
+    const char *p = list;
+
+    if (!list)
+        return 1;
+    while ((p = strstr(p, name))) {
+        if ((p == list || p[-1] == ',') && (p[len] == ',' || !p[len]))
+            return 1;
+        p += len;
+    }
+    return 0;
+}
+
+static void set_kernel_timing(const struct bench_dev *dev, const char *value) {
+    int fd = open(dev->param, O_WRONLY);
+
+    if (fd < 0)
+        return;
+    if (write(fd, value, 1) < 0)
+        perror(dev->param);
+    close(fd);
+}
+
+static void usage(const char *prog) {
+    fprintf(stderr,
+            "Usage: %s [options]\n"
+            "  -c PATH     simple_chardev node (default /dev/simple_chardev)\n"
+            "  -i PATH     ioctl_dev node (default /dev/ioctl_dev)\n"
+            "  -d LIST     devices to run: chardev,ioctl (default both)\n"
+            "  -o LIST     ops to run (default all)\n"
+            "  -t N        max threads; runs 1,2,4..N (default online CPUs)\n"
+            "  -s LIST     payload sizes for sized ops (default " DEFAULT_SIZES ")\n"
+            "  -D SECS     duration of each run (default 1.0)\n"
+            "  -k          enable and report the in-kernel timing hooks\n"
+            "  -j          JSON output instead of CSV\n",
+            prog);
+}
+
+int main(int argc, char **argv) {
+    const char *dev_list = NULL, *op_list = NULL;
+    const char *size_arg = DEFAULT_SIZES;
+    size_t sizes[MAX_SIZES];
+    int nr_sizes = 0, max_threads = sysconf(_SC_NPROCESSORS_ONLN);
+    int kernel = 0, json = 0, first = 1;
+    double duration = 1.0;
+    char *copy, *tok;
+    size_t i, d;
+    int opt, s, t;
+
+    while ((opt = getopt(argc, argv, "c:i:d:o:t:s:D:kjh")) != -1) {
+        switch (opt) {
+        case 'c': devices[0].path = optarg; break;
+        case 'i': devices[1].path = optarg; break;
+        case 'd': dev_list = optarg; break;
+        case 'o': op_list = optarg; break;
+        case 't': max_threads = atoi(optarg); break;
+        case 's': size_arg = optarg; break;
+        case 'D': duration = atof(optarg); break;
+        case 'k': kernel = 1; break;
+        case 'j': json = 1; break;
+        default:
+            usage(argv[0]);
+            return opt == 'h' ? 0 : 1;
+        }
+    }
+    if (max_threads < 1 || duration <= 0) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    copy = strdup(size_arg);
+    for (tok = strtok(copy, ","); tok && nr_sizes < MAX_SIZES; tok = strtok(NULL, ","))
+        sizes[nr_sizes++] = strtoul(tok, NULL, 0);
+    free(copy);
+
+    if (kernel)
+        for (d = 0; d < sizeof(devices) / sizeof(devices[0]); d++)
+            set_kernel_timing(&devices[d], "Y");
+
+    if (json)
+        printf("[");
+    else
+        printf("device,op,threads,size,ops,seconds,ops_per_sec,ns_per_op,kernel_ns_per_op\n");
+
+    for (d = 0; d < sizeof(devices) / sizeof(devices[0]); d++) {
+        const struct bench_dev *dev = &devices[d];
+
+        if (!in_list(dev_list, dev->name))
+            continue;
+        if (access(dev->path, R_OK | W_OK)) {
+            fprintf(stderr, "Skipping %s: %s: %s\n", dev->name, dev->path,
+                    strerror(errno));
+            continue;
+        }
+
+        for (i = 0; i < sizeof(ops) / sizeof(ops[0]); i++) {
+            const struct bench_op *op = &ops[i];
+
+            if (strcmp(op->device, dev->name) || !in_list(op_list, op->name))
+                continue;
+
+            for (t = 1; t <= max_threads; t = next_threads(t, max_threads))
+                for (s = 0; s < (op->sized ? nr_sizes : 1); s++)
+                    run_one(op, dev, t, op->sized ? sizes[s] : 0,
+                            duration, kernel, json, &first);
+        }
+    }
+
+    if (json)
+        printf("\n]\n");
+
+    if (kernel)
+        for (d = 0; d < sizeof(devices) / sizeof(devices[0]); d++)
+            set_kernel_timing(&devices[d], "N");
+    return 0;
+}
@@ -4,95 +4,829 @@
 #include <linux/fs.h>
 #include <linux/uaccess.h>
 #include <linux/cdev.h>
+#include <linux/mm.h>
+#include <linux/highmem.h>
+#include <linux/mutex.h>
+#include <linux/pipe_fs_i.h>
+#include <linux/splice.h>
+#include <linux/uio.h>
+#include <linux/slab.h>
+#include <linux/vmalloc.h>
+#include <linux/wait.h>
+#include <linux/ioctl.h>
+#include <linux/numa.h>
+#include <linux/topology.h>
+#include <linux/smp.h>
+#include <linux/percpu.h>
+#include <linux/ktime.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
 
 #define DEVICE_NAME "simple_chardev"
-#define BUF_SIZE 1024
+#define BUF_PAGES 16
+#define BUF_SIZE (BUF_PAGES * PAGE_SIZE)
+#define REC_RING_SIZE (64 * 1024)
+#define REC_HDR_SIZE sizeof(u32)
+#define REC_MAX_BATCH 256
+
+#define CHARDEV_MAGIC 'c'
+
+struct chardev_rec_offsets {
+    __u32 max;      // Entries available at offsets
+    __u32 count;    // Filled in: records returned by the last read()
+    __u64 offsets;  // User pointer to __u32[max], start of each record
+};
+
+#define CHARDEV_SET_RECORD_MODE _IOW(CHARDEV_MAGIC, 1, int)
+#define CHARDEV_GET_RECORD_OFFSETS _IOWR(CHARDEV_MAGIC, 2, struct chardev_rec_offsets)
 
 static dev_t dev_num;
 static struct cdev my_cdev;
-static char kernel_buffer[BUF_SIZE];
-static int buffer_pointer = 0;
+
+/*
+ * One channel per minor, each with its own buffers and locks so that
+ * independent producer/consumer pairs never contend with each other.
+ */
+struct chardev_channel {
+    int index;
+    int node;                   // NUMA node all buffers are allocated on
+    /*
+     * The buffer is kept as individual pages so splice() can hand them to
+     * a pipe by reference. A page still referenced by a pipe is never
+     * written in place; the writer swaps in a fresh page instead.
+     */
+    struct page *buf_pages[BUF_PAGES];
+    int buffer_pointer;
+    struct mutex buf_lock;
+    /*
+     * Record mode keeps write boundaries: every write() becomes one record
+     * in this ring, stored as a u32 length followed by the payload.
+     */
+    char *rec_ring;
+    size_t rec_head;            // Next byte to write
+    size_t rec_tail;            // Next byte to read
+    size_t rec_used;
+    struct mutex rec_lock;
+    wait_queue_head_t rec_readq;
+    wait_queue_head_t rec_writeq;
+};
+
+static struct chardev_channel **channels;
+static unsigned int nr_minors;
+
+static unsigned int nr_channels = 1;
+module_param(nr_channels, uint, 0444);
+MODULE_PARM_DESC(nr_channels, "Number of independent channels (minors 0..N-1)");
+
+static int numa_node = NUMA_NO_NODE;
+module_param(numa_node, int, 0444);
+MODULE_PARM_DESC(numa_node,
+                 "NUMA node for channel buffers (-1: node of the CPUs each channel serves)");
+
+static bool local_node = true;
+module_param(local_node, bool, 0444);
+MODULE_PARM_DESC(local_node,
+                 "Add minor N that routes each opener to the channel of its current CPU");
+
+static bool record_mode_default;
+module_param(record_mode_default, bool, 0644);
+MODULE_PARM_DESC(record_mode_default, "Open new file descriptors in record mode");
+
+/*
+ * CPUs are split into nr_channels contiguous blocks, which keeps a block
+ * on one socket when CPU numbering follows the topology.
+ */
+static unsigned int cpu_to_channel(unsigned int cpu) {
+    return (u64)cpu * nr_channels / nr_cpu_ids;
+}
+
+/*
+ * Optional per-op timing for the benchmark suite. Counters are per-CPU so
+ * enabling them does not add a shared cache line to every operation.
+ */
+enum {
+    T_OPEN,
+    T_RELEASE,
+    T_READ,
+    T_WRITE,
+    T_SPLICE_READ,
+    T_SPLICE_WRITE,
+    T_SET_RECORD_MODE,
+    T_GET_RECORD_OFFSETS,
+    T_NR,
+};
+
+static const char * const timing_names[T_NR] = {
+    [T_OPEN] = "open",
+    [T_RELEASE] = "release",
+    [T_READ] = "read",
+    [T_WRITE] = "write",
+    [T_SPLICE_READ] = "splice_read",
+    [T_SPLICE_WRITE] = "splice_write",
+    [T_SET_RECORD_MODE] = "set_record_mode",
+    [T_GET_RECORD_OFFSETS] = "get_record_offsets",
+};
+
+struct op_timing {
+    u64 count[T_NR];
+    u64 ns[T_NR];
+};
+
+static DEFINE_PER_CPU(struct op_timing, op_timing);
+static struct dentry *debugfs_dir;
+
+static bool timing;
+module_param(timing, bool, 0644);
+MODULE_PARM_DESC(timing, "Record per-op kernel time in debugfs simple_chardev/timing");
+
+static inline u64 timing_start(void) {
+    return READ_ONCE(timing) ? ktime_get_ns() : 0;
+}
+
+static inline void timing_end(int op, u64 t0) {
+    if (!t0)
+        return;
+    this_cpu_inc(op_timing.count[op]);
+    this_cpu_add(op_timing.ns[op], ktime_get_ns() - t0);
+}
+
+// "<op> <count> <total_ns>" per line; any write clears the counters
+static int timing_show(struct seq_file *s, void *unused) {
+    int op, cpu;
+    
+    for (op = 0; op < T_NR; op++) {
+        u64 count = 0, ns = 0;
+        
+        for_each_possible_cpu(cpu) {
+            count += per_cpu(op_timing, cpu).count[op];
+            ns += per_cpu(op_timing, cpu).ns[op];
+        }
+        seq_printf(s, "%s %llu %llu\n", timing_names[op], count, ns);
+    }
+    return 0;
+}
+
+static int timing_open(struct inode *inode, struct file *file) {
+    return single_open(file, timing_show, NULL);
+}
+
+static ssize_t timing_write(struct file *file, const char __user *buf,
+                            size_t count, loff_t *ppos) {
+    int cpu;
+    
+    for_each_possible_cpu(cpu)
+        memset(per_cpu_ptr(&op_timing, cpu), 0, sizeof(struct op_timing));
+    return count;
+}
+
+static const struct file_operations timing_fops = {
+    .owner = THIS_MODULE,
+    .open = timing_open,
+    .read = seq_read,
+    .write = timing_write,
+    .llseek = seq_lseek,
+    .release = single_release,
+};
+
+struct chardev_file {
+    struct chardev_channel *ch;
+    bool record_mode;
+    u32 nr_offsets;                 // Records returned by the last read()
+    u32 offsets[REC_MAX_BATCH];
+};
 
 static int device_open(struct inode *inode, struct file *file) {
-    pr_info("%s: Device opened\n", DEVICE_NAME);
+    u64 t0 = timing_start();
+    struct chardev_file *cf;
+    
+    cf = kzalloc(sizeof(*cf), GFP_KERNEL);
+    if (!cf)
+        return -ENOMEM;
+    
+    // The extra "local" minor picks the channel serving this CPU
+    if (iminor(inode) == nr_channels)
+        cf->ch = channels[cpu_to_channel(raw_smp_processor_id())];
+    else
+        cf->ch = channels[iminor(inode)];
+    cf->record_mode = READ_ONCE(record_mode_default);
+    file->private_data = cf;
+    
+    timing_end(T_OPEN, t0);
     return 0;
 }
 
 static int device_release(struct inode *inode, struct file *file) {
-    pr_info("%s: Device closed\n", DEVICE_NAME);
+    u64 t0 = timing_start();
+    
+    kfree(file->private_data);
+    pr_debug("%s: Device closed\n", DEVICE_NAME);
+    timing_end(T_RELEASE, t0);
     return 0;
 }
 
-static ssize_t device_read(struct file *filp, char __user *buffer, 
-                          size_t len, loff_t *offset) {
-    int bytes_read = 0;
+static void rec_ring_get(struct chardev_channel *ch, size_t pos,
+                         void *dst, size_t len) {
+    size_t first = min(len, REC_RING_SIZE - pos);
+    
+    memcpy(dst, ch->rec_ring + pos, first);
+    memcpy((char *)dst + first, ch->rec_ring, len - first);
+}
+
+static void rec_ring_put(struct chardev_channel *ch, size_t pos,
+                         const void *src, size_t len) {
+    size_t first = min(len, REC_RING_SIZE - pos);
+    
+    memcpy(ch->rec_ring + pos, src, first);
+    memcpy(ch->rec_ring, (const char *)src + first, len - first);
+}
+
+static bool rec_ring_copy_to_iter(struct chardev_channel *ch, size_t pos,
+                                  size_t len, struct iov_iter *to) {
+    size_t first = min(len, REC_RING_SIZE - pos);
+    
+    if (copy_to_iter(ch->rec_ring + pos, first, to) != first)
+        return false;
+    return copy_to_iter(ch->rec_ring, len - first, to) == len - first;
+}
+
+static bool rec_ring_copy_from_iter(struct chardev_channel *ch, size_t pos,
+                                    size_t len, struct iov_iter *from) {
+    size_t first = min(len, REC_RING_SIZE - pos);
+    
+    if (copy_from_iter(ch->rec_ring + pos, first, from) != first)
+        return false;
+    return copy_from_iter(ch->rec_ring, len - first, from) == len - first;
+}
+
+/*
+ * Return as many whole records as fit in the user buffer, payloads back to
+ * back. Where each one starts is available via CHARDEV_GET_RECORD_OFFSETS.
+ */
+static ssize_t record_read_iter(struct kiocb *iocb, struct iov_iter *to) {
+    struct chardev_file *cf = iocb->ki_filp->private_data;
+    struct chardev_channel *ch = cf->ch;
+    size_t room = iov_iter_count(to);
+    size_t done = 0;
+    bool fault = false;
+    u32 n = 0;
+    int ret;
+    
+    mutex_lock(&ch->rec_lock);
+    
+    while (!ch->rec_used) {
+        mutex_unlock(&ch->rec_lock);
+        if (iocb->ki_filp->f_flags & O_NONBLOCK)
+            return -EAGAIN;
+        ret = wait_event_interruptible(ch->rec_readq, READ_ONCE(ch->rec_used));
+        if (ret)
+            return ret;
+        mutex_lock(&ch->rec_lock);
+    }
+    
+    while (ch->rec_used && n < REC_MAX_BATCH) {
+        u32 rec_len;
+        
+        rec_ring_get(ch, ch->rec_tail, &rec_len, REC_HDR_SIZE);
+        if (done + rec_len > room)
+            break;
+        
+        if (!rec_ring_copy_to_iter(ch, (ch->rec_tail + REC_HDR_SIZE) % REC_RING_SIZE,
+                                   rec_len, to)) {
+            fault = true;
+            break;
+        }
+        
+        cf->offsets[n++] = done;
+        done += rec_len;
+        ch->rec_tail = (ch->rec_tail + REC_HDR_SIZE + rec_len) % REC_RING_SIZE;
+        ch->rec_used -= REC_HDR_SIZE + rec_len;
+    }
+    
+    mutex_unlock(&ch->rec_lock);
+    
+    cf->nr_offsets = n;
+    if (!n)
+        return fault ? -EFAULT : -EMSGSIZE;
+    
+    wake_up_interruptible(&ch->rec_writeq);
+    pr_debug("%s: Read %u records (%zu bytes)\n", DEVICE_NAME, n, done);
+    return done;
+}
+
+static ssize_t record_write_iter(struct kiocb *iocb, struct iov_iter *from) {
+    struct chardev_file *cf = iocb->ki_filp->private_data;
+    struct chardev_channel *ch = cf->ch;
+    size_t count = iov_iter_count(from);
+    size_t need = REC_HDR_SIZE + count;
+    u32 len = count;
+    int ret;
     
-    if (*offset >= buffer_pointer)
+    // An empty record would read back as 0, which callers take for EOF
+    if (!count)
+        return -EINVAL;
+    if (count > REC_RING_SIZE - REC_HDR_SIZE)
+        return -EMSGSIZE;
+    
+    mutex_lock(&ch->rec_lock);
+    
+    while (REC_RING_SIZE - ch->rec_used < need) {
+        mutex_unlock(&ch->rec_lock);
+        if (iocb->ki_filp->f_flags & O_NONBLOCK)
+            return -EAGAIN;
+        ret = wait_event_interruptible(ch->rec_writeq,
+                                       REC_RING_SIZE - READ_ONCE(ch->rec_used) >= need);
+        if (ret)
+            return ret;
+        mutex_lock(&ch->rec_lock);
+    }
+    
+    // Payload first; the record only becomes visible once it is complete
+    if (!rec_ring_copy_from_iter(ch, (ch->rec_head + REC_HDR_SIZE) % REC_RING_SIZE,
+                                 len, from)) {
+        mutex_unlock(&ch->rec_lock);
+        return -EFAULT;
+    }
+    rec_ring_put(ch, ch->rec_head, &len, REC_HDR_SIZE);
+    ch->rec_head = (ch->rec_head + need) % REC_RING_SIZE;
+    ch->rec_used += need;
+    
+    mutex_unlock(&ch->rec_lock);
+    
+    wake_up_interruptible(&ch->rec_readq);
+    return len;
+}
+
+static ssize_t buffer_read_iter(struct kiocb *iocb, struct iov_iter *to) {
+    struct chardev_file *cf = iocb->ki_filp->private_data;
+    struct chardev_channel *ch = cf->ch;
+    loff_t pos = iocb->ki_pos;
+    size_t len = iov_iter_count(to);
+    size_t bytes_read = 0;
+    
+    mutex_lock(&ch->buf_lock);
+    
+    if (pos >= ch->buffer_pointer) {
+        mutex_unlock(&ch->buf_lock);
         return 0;
+    }
+    
+    if (pos + len > ch->buffer_pointer)
+        len = ch->buffer_pointer - pos;
+    
+    while (bytes_read < len) {
+        size_t off = offset_in_page(pos);
+        size_t chunk = min_t(size_t, PAGE_SIZE - off, len - bytes_read);
+        size_t copied = copy_page_to_iter(ch->buf_pages[pos >> PAGE_SHIFT],
+                                          off, chunk, to);
+        
+        bytes_read += copied;
+        pos += copied;
+        if (copied < chunk)
+            break;
+    }
     
-    if (*offset + len > buffer_pointer)
-        len = buffer_pointer - *offset;
+    mutex_unlock(&ch->buf_lock);
     
-    if (copy_to_user(buffer, kernel_buffer + *offset, len))
+    if (!bytes_read && len)
         return -EFAULT;
     
-    *offset += len;
-    bytes_read = len;
+    iocb->ki_pos = pos;
     
-    pr_info("%s: Read %d bytes\n", DEVICE_NAME, bytes_read);
+    pr_debug("%s: Read %zu bytes\n", DEVICE_NAME, bytes_read);
     return bytes_read;
 }
 
-static ssize_t device_write(struct file *filp, const char __user *buffer,
-                           size_t len, loff_t *offset) {
+/*
+ * Replace a page that a pipe still holds so its reader keeps the old data.
+ * The copy carries the current contents over, so a write that faults part
+ * way through never exposes an uninitialised page below buffer_pointer.
+ */
+static int buf_page_make_private(struct chardev_channel *ch, int idx) {
+    struct page *page;
+    
+    if (page_count(ch->buf_pages[idx]) == 1)
+        return 0;
+    
+    page = alloc_pages_node(ch->node, GFP_KERNEL, 0);
+    if (!page)
+        return -ENOMEM;
+    
+    copy_highpage(page, ch->buf_pages[idx]);
+    put_page(ch->buf_pages[idx]);
+    ch->buf_pages[idx] = page;
+    return 0;
+}
+
+static ssize_t buffer_write_iter(struct kiocb *iocb, struct iov_iter *from) {
+    struct chardev_file *cf = iocb->ki_filp->private_data;
+    struct chardev_channel *ch = cf->ch;
+    size_t len = iov_iter_count(from);
+    size_t done = 0;
+    int i, ret;
+    
     if (len > BUF_SIZE - 1)
         len = BUF_SIZE - 1;
     
-    if (copy_from_user(kernel_buffer, buffer, len))
-        return -EFAULT;
+    mutex_lock(&ch->buf_lock);
+    
+    // Pages covering the data plus the trailing NUL
+    for (i = 0; i <= (len >> PAGE_SHIFT); i++) {
+        ret = buf_page_make_private(ch, i);
+        if (ret) {
+            mutex_unlock(&ch->buf_lock);
+            return ret;
+        }
+    }
     
-    kernel_buffer[len] = '\0';
-    buffer_pointer = len;
+    while (done < len) {
+        size_t off = offset_in_page(done);
+        size_t chunk = min_t(size_t, PAGE_SIZE - off, len - done);
+        
+        if (copy_page_from_iter(ch->buf_pages[done >> PAGE_SHIFT], off,
+                                chunk, from) != chunk) {
+            mutex_unlock(&ch->buf_lock);
+            return -EFAULT;
+        }
+        done += chunk;
+    }
+    
+    ((char *)page_address(ch->buf_pages[len >> PAGE_SHIFT]))[offset_in_page(len)] = '\0';
+    ch->buffer_pointer = len;
+    
+    mutex_unlock(&ch->buf_lock);
     
-    pr_info("%s: Wrote %zu bytes\n", DEVICE_NAME, len);
+    pr_debug("%s: Wrote %zu bytes\n", DEVICE_NAME, len);
     return len;
 }
 
+static void device_spd_release(struct splice_pipe_desc *spd, unsigned int i) {
+    put_page(spd->pages[i]);
+}
+
+static const struct pipe_buf_operations device_pipe_buf_ops = {
+    .release = generic_pipe_buf_release,
+    .get = generic_pipe_buf_get,
+};
+
+/*
+ * Zero-copy read side: the pipe gets references to the buffer pages
+ * themselves, so splice()/sendfile() to a socket or file never copies
+ * the data through a user buffer.
+ */
+static ssize_t buffer_splice_read(struct file *in, loff_t *ppos,
+                                  struct pipe_inode_info *pipe,
+                                  size_t len, unsigned int flags) {
+    struct page *pages[PIPE_DEF_BUFFERS];
+    struct partial_page partial[PIPE_DEF_BUFFERS];
+    struct splice_pipe_desc spd = {
+        .pages = pages,
+        .partial = partial,
+        .nr_pages_max = PIPE_DEF_BUFFERS,
+        .ops = &device_pipe_buf_ops,
+        .spd_release = device_spd_release,
+    };
+    struct chardev_file *cf = in->private_data;
+    struct chardev_channel *ch = cf->ch;
+    loff_t pos = *ppos;
+    ssize_t ret;
+    
+    // Records have no stable page backing to lend out
+    if (cf->record_mode)
+        return -EINVAL;
+    
+    mutex_lock(&ch->buf_lock);
+    
+    if (pos >= ch->buffer_pointer) {
+        mutex_unlock(&ch->buf_lock);
+        return 0;
+    }
+    
+    if (pos + len > ch->buffer_pointer)
+        len = ch->buffer_pointer - pos;
+    
+    while (len && spd.nr_pages < PIPE_DEF_BUFFERS) {
+        size_t off = offset_in_page(pos);
+        size_t chunk = min_t(size_t, PAGE_SIZE - off, len);
+        struct page *page = ch->buf_pages[pos >> PAGE_SHIFT];
+        
+        get_page(page);
+        pages[spd.nr_pages] = page;
+        partial[spd.nr_pages].offset = off;
+        partial[spd.nr_pages].len = chunk;
+        spd.nr_pages++;
+        
+        pos += chunk;
+        len -= chunk;
+    }
+    
+    mutex_unlock(&ch->buf_lock);
+    
+    ret = splice_to_pipe(pipe, &spd);
+    if (ret > 0) {
+        *ppos += ret;
+        pr_debug("%s: Spliced %zd bytes\n", DEVICE_NAME, ret);
+    }
+    return ret;
+}
+
+/*
+ * Copy one pipe buffer into the byte buffer at sd->pos. Data ends where
+ * the copy ends, like a write(), but later buffers of the same splice
+ * land after this one instead of overwriting it.
+ */
+static int buffer_splice_actor(struct pipe_inode_info *pipe,
+                               struct pipe_buffer *buf,
+                               struct splice_desc *sd) {
+    struct chardev_file *cf = sd->u.file->private_data;
+    struct chardev_channel *ch = cf->ch;
+    loff_t pos = sd->pos;
+    size_t len, done = 0;
+    int i, ret;
+    
+    if (pos >= BUF_SIZE - 1)
+        return -ENOSPC;
+    len = min_t(size_t, sd->len, BUF_SIZE - 1 - pos);
+    
+    mutex_lock(&ch->buf_lock);
+    
+    for (i = pos >> PAGE_SHIFT; i <= ((pos + len) >> PAGE_SHIFT); i++) {
+        ret = buf_page_make_private(ch, i);
+        if (ret) {
+            mutex_unlock(&ch->buf_lock);
+            return ret;
+        }
+    }
+    
+    // Pipe buffers from large folios can span several source pages
+    while (done < len) {
+        size_t src = buf->offset + done;
+        size_t off = offset_in_page(pos + done);
+        size_t chunk = min_t(size_t, PAGE_SIZE - max(off, offset_in_page(src)),
+                             len - done);
+        
+        memcpy_page(ch->buf_pages[(pos + done) >> PAGE_SHIFT], off,
+                    nth_page(buf->page, src >> PAGE_SHIFT),
+                    offset_in_page(src), chunk);
+        done += chunk;
+    }
+    
+    ((char *)page_address(ch->buf_pages[(pos + len) >> PAGE_SHIFT]))[offset_in_page(pos + len)] = '\0';
+    ch->buffer_pointer = pos + len;
+    
+    mutex_unlock(&ch->buf_lock);
+    return len;
+}
+
+/*
+ * Splice into the byte buffer at *ppos. iter_file_splice_write() would
+ * call write_iter once per pipe-full, and each of those replaces the
+ * buffer from offset 0, so only the last chunk would survive.
+ */
+static ssize_t buffer_splice_write(struct pipe_inode_info *pipe,
+                                   struct file *out, loff_t *ppos,
+                                   size_t len, unsigned int flags) {
+    struct chardev_file *cf = out->private_data;
+    struct splice_desc sd = {
+        .flags = flags,
+        .pos = *ppos,
+        .u.file = out,
+    };
+    ssize_t ret;
+    
+    // Each pipe-full becomes one record
+    if (cf->record_mode)
+        return iter_file_splice_write(pipe, out, ppos, len, flags);
+    
+    if (*ppos < 0)
+        return -EINVAL;
+    if (*ppos >= BUF_SIZE - 1)
+        return -ENOSPC;
+    sd.total_len = min_t(size_t, len, BUF_SIZE - 1 - *ppos);
+    
+    pipe_lock(pipe);
+    ret = __splice_from_pipe(pipe, &sd, buffer_splice_actor);
+    pipe_unlock(pipe);
+    
+    if (ret > 0) {
+        *ppos = sd.pos;
+        pr_debug("%s: Spliced in %zd bytes\n", DEVICE_NAME, ret);
+    }
+    return ret;
+}
+
+static long chardev_ioctl(struct file *file, unsigned int cmd, unsigned long arg) {
+    struct chardev_file *cf = file->private_data;
+    struct chardev_rec_offsets req;
+    int mode;
+    
+    switch (cmd) {
+    case CHARDEV_SET_RECORD_MODE:
+        if (copy_from_user(&mode, (int __user *)arg, sizeof(int)))
+            return -EFAULT;
+        cf->record_mode = !!mode;
+        pr_debug("%s: %s mode\n", DEVICE_NAME, mode ? "Record" : "Byte");
+        break;
+        
+    case CHARDEV_GET_RECORD_OFFSETS:
+        if (copy_from_user(&req, (void __user *)arg, sizeof(req)))
+            return -EFAULT;
+        req.count = min(req.max, cf->nr_offsets);
+        if (copy_to_user(u64_to_user_ptr(req.offsets), cf->offsets,
+                         req.count * sizeof(u32)))
+            return -EFAULT;
+        req.count = cf->nr_offsets;
+        if (copy_to_user((void __user *)arg, &req, sizeof(req)))
+            return -EFAULT;
+        break;
+        
+    default:
+        return -ENOTTY;
+    }
+    
+    return 0;
+}
+
+/* fops entry points: pick the mode-specific handler and time it */
+static ssize_t device_read_iter(struct kiocb *iocb, struct iov_iter *to) {
+    struct chardev_file *cf = iocb->ki_filp->private_data;
+    u64 t0 = timing_start();
+    ssize_t ret;
+    
+    ret = cf->record_mode ? record_read_iter(iocb, to) :
+                            buffer_read_iter(iocb, to);
+    timing_end(T_READ, t0);
+    return ret;
+}
+
+static ssize_t device_write_iter(struct kiocb *iocb, struct iov_iter *from) {
+    struct chardev_file *cf = iocb->ki_filp->private_data;
+    u64 t0 = timing_start();
+    ssize_t ret;
+    
+    ret = cf->record_mode ? record_write_iter(iocb, from) :
+                            buffer_write_iter(iocb, from);
+    timing_end(T_WRITE, t0);
+    return ret;
+}
+
+static ssize_t device_splice_read(struct file *in, loff_t *ppos,
+                                  struct pipe_inode_info *pipe,
+                                  size_t len, unsigned int flags) {
+    u64 t0 = timing_start();
+    ssize_t ret = buffer_splice_read(in, ppos, pipe, len, flags);
+    
+    timing_end(T_SPLICE_READ, t0);
+    return ret;
+}
+
+static ssize_t device_splice_write(struct pipe_inode_info *pipe,
+                                   struct file *out, loff_t *ppos,
+                                   size_t len, unsigned int flags) {
+    u64 t0 = timing_start();
+    ssize_t ret = buffer_splice_write(pipe, out, ppos, len, flags);
+    
+    timing_end(T_SPLICE_WRITE, t0);
+    return ret;
+}
+
+static long device_ioctl(struct file *file, unsigned int cmd, unsigned long arg) {
+    u64 t0 = timing_start();
+    long ret = chardev_ioctl(file, cmd, arg);
+    
+    if (cmd == CHARDEV_SET_RECORD_MODE)
+        timing_end(T_SET_RECORD_MODE, t0);
+    else if (cmd == CHARDEV_GET_RECORD_OFFSETS)
+        timing_end(T_GET_RECORD_OFFSETS, t0);
+    return ret;
+}
+
 static struct file_operations fops = {
     .owner = THIS_MODULE,
     .open = device_open,
     .release = device_release,
-    .read = device_read,
-    .write = device_write,
+    .read_iter = device_read_iter,
+    .write_iter = device_write_iter,
+    .splice_read = device_splice_read,
+    .splice_write = device_splice_write,
+    .unlocked_ioctl = device_ioctl,
 };
 
+static void channel_free(struct chardev_channel *ch) {
+    int i;
+    
+    if (!ch)
+        return;
+    
+    for (i = 0; i < BUF_PAGES; i++) {
+        if (ch->buf_pages[i])
+            put_page(ch->buf_pages[i]);
+    }
+    vfree(ch->rec_ring);
+    kfree(ch);
+}
+
+static struct chardev_channel *channel_alloc(int index) {
+    struct chardev_channel *ch;
+    unsigned int first_cpu = DIV_ROUND_UP(index * nr_cpu_ids, nr_channels);
+    int node = numa_node;
+    int i;
+    
+    // By default place each channel next to the CPUs "local" routes to it
+    if (node == NUMA_NO_NODE && first_cpu < nr_cpu_ids && cpu_possible(first_cpu))
+        node = cpu_to_node(first_cpu);
+    
+    ch = kzalloc_node(sizeof(*ch), GFP_KERNEL, node);
+    if (!ch)
+        return NULL;
+    
+    ch->index = index;
+    ch->node = node;
+    mutex_init(&ch->buf_lock);
+    mutex_init(&ch->rec_lock);
+    init_waitqueue_head(&ch->rec_readq);
+    init_waitqueue_head(&ch->rec_writeq);
+    
+    ch->rec_ring = vmalloc_node(REC_RING_SIZE, node);
+    if (!ch->rec_ring)
+        goto err;
+    
+    for (i = 0; i < BUF_PAGES; i++) {
+        ch->buf_pages[i] = alloc_pages_node(node, GFP_KERNEL | __GFP_ZERO, 0);
+        if (!ch->buf_pages[i])
+            goto err;
+    }
+    
+    return ch;
+    
+err:
+    channel_free(ch);
+    return NULL;
+}
+
+static void free_channels(void) {
+    unsigned int i;
+    
+    for (i = 0; i < nr_channels; i++)
+        channel_free(channels[i]);
+    kfree(channels);
+}
+
 static int __init chardev_init(void) {
+    unsigned int i;
     int ret;
     
-    ret = alloc_chrdev_region(&dev_num, 0, 1, DEVICE_NAME);
+    if (!nr_channels || nr_channels > MINORMASK)
+        return -EINVAL;
+    if (numa_node != NUMA_NO_NODE &&
+        (numa_node < 0 || numa_node >= MAX_NUMNODES || !node_online(numa_node)))
+        return -EINVAL;
+    
+    nr_minors = nr_channels + (local_node ? 1 : 0);
+    
+    channels = kcalloc(nr_channels, sizeof(*channels), GFP_KERNEL);
+    if (!channels)
+        return -ENOMEM;
+    
+    for (i = 0; i < nr_channels; i++) {
+        channels[i] = channel_alloc(i);
+        if (!channels[i]) {
+            free_channels();
+            return -ENOMEM;
+        }
+    }
+    
+    ret = alloc_chrdev_region(&dev_num, 0, nr_minors, DEVICE_NAME);
     if (ret < 0) {
         pr_err("%s: Failed to allocate device number\n", DEVICE_NAME);
+        free_channels();
         return ret;
     }
     
     cdev_init(&my_cdev, &fops);
     my_cdev.owner = THIS_MODULE;
     
-    ret = cdev_add(&my_cdev, dev_num, 1);
+    ret = cdev_add(&my_cdev, dev_num, nr_minors);
     if (ret < 0) {
-        unregister_chrdev_region(dev_num, 1);
+        unregister_chrdev_region(dev_num, nr_minors);
+        free_channels();
         pr_err("%s: Failed to add cdev\n", DEVICE_NAME);
         return ret;
     }
     
-    pr_info("%s: Registered with major number %d\n", 
-            DEVICE_NAME, MAJOR(dev_num));
+    debugfs_dir = debugfs_create_dir(DEVICE_NAME, NULL);
+    debugfs_create_file("timing", 0600, debugfs_dir, NULL, &timing_fops);
+    
+    pr_info("%s: Registered with major number %d, %u channels%s\n", 
+            DEVICE_NAME, MAJOR(dev_num), nr_channels,
+            local_node ? " + local" : "");
     return 0;
 }
 
 static void __exit chardev_exit(void) {
+    debugfs_remove_recursive(debugfs_dir);
     cdev_del(&my_cdev);
-    unregister_chrdev_region(dev_num, 1);
+    unregister_chrdev_region(dev_num, nr_minors);
+    free_channels();
     pr_info("%s: Unregistered\n", DEVICE_NAME);
 }
 
@@ -102,4 +836,4 @@ module_exit(chardev_exit);
 MODULE_LICENSE("GPL");
 MODULE_AUTHOR("Your Name");
 MODULE_DESCRIPTION("Simple Character Device Driver");
-MODULE_VERSION("1.0");
\ No newline at end of file
+MODULE_VERSION("1.0");
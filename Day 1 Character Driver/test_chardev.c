@@ -0,0 +1,240 @@
+// test_chardev.c - userspace checks for simple_chardev
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <linux/types.h>
+
+#define DEVICE_PATH "/dev/simple_chardev"
+
+#define CHARDEV_MAGIC 'c'
+
+struct chardev_rec_offsets {
+    __u32 max;
+    __u32 count;
+    __u64 offsets;
+};
+
+#define CHARDEV_SET_RECORD_MODE _IOW(CHARDEV_MAGIC, 1, int)
+#define CHARDEV_GET_RECORD_OFFSETS _IOWR(CHARDEV_MAGIC, 2, struct chardev_rec_offsets)
+
+#define SPLICE_LEN 20000    // Spans several buffer pages, not page aligned
+#define SPLICE_SKIP 5000
+
+static int failures;
+
+static void check(int ok, const char *what) {
+    printf("  %-52s %s\n", what, ok ? "ok" : "FAILED");
+    if (!ok)
+        failures++;
+}
+
+static void fill_pattern(char *buf, size_t len) {
+    size_t i;
+
+    for (i = 0; i < len; i++)
+        buf[i] = 'a' + (i * 7 + i / 4096) % 26;
+}
+
+// Drain exactly len bytes from the pipe
+static int pipe_read_all(int fd, char *buf, size_t len) {
+    size_t done = 0;
+
+    while (done < len) {
+        ssize_t n = read(fd, buf + done, len - done);
+
+        if (n <= 0)
+            return -1;
+        done += n;
+    }
+    return 0;
+}
+
+/*
+ * splice() the byte buffer into a pipe, once with an explicit offset and
+ * once through the file position, and compare what comes out of the pipe
+ * with what was written. Then splice several pipe buffers back in and
+ * check none of them overwrote another.
+ */
+static void test_splice(void) {
+    static char pattern[SPLICE_LEN], out[SPLICE_LEN];
+    int fd, p[2];
+    loff_t off;
+    ssize_t n;
+
+    printf("Splice to and from pipe...\n");
+
+    fd = open(DEVICE_PATH, O_RDWR);
+    if (fd < 0 || pipe(p) < 0) {
+        perror("open/pipe");
+        failures++;
+        return;
+    }
+
+    fill_pattern(pattern, sizeof(pattern));
+    check(write(fd, pattern, sizeof(pattern)) == sizeof(pattern),
+          "write pattern");
+
+    // Explicit offset: the data comes from there and only *off moves
+    off = SPLICE_SKIP;
+    n = splice(fd, &off, p[1], NULL, sizeof(out), 0);
+    check(n == SPLICE_LEN - SPLICE_SKIP, "splice returns bytes up to end of data");
+    check(off == SPLICE_SKIP + n, "splice advances the offset it was given");
+    check(n > 0 && pipe_read_all(p[0], out, n) == 0 &&
+          !memcmp(out, pattern + SPLICE_SKIP, n), "pipe data matches buffer");
+
+    n = splice(fd, &off, p[1], NULL, sizeof(out), 0);
+    check(n == 0, "splice at end of data returns 0");
+
+    // No offset: splice consumes the file position, read() continues there
+    n = splice(fd, NULL, p[1], NULL, SPLICE_SKIP, 0);
+    check(n == SPLICE_SKIP, "splice from file position");
+    check(pipe_read_all(p[0], out, SPLICE_SKIP) == 0 &&
+          !memcmp(out, pattern, SPLICE_SKIP), "pipe data matches buffer start");
+    n = read(fd, out, sizeof(out));
+    check(n == SPLICE_LEN - SPLICE_SKIP &&
+          !memcmp(out, pattern + SPLICE_SKIP, n), "read() resumes after spliced bytes");
+
+    // Pipe -> device: 5 pipe buffers in one splice, then more appended
+    fill_pattern(pattern, sizeof(pattern));
+    pattern[0] ^= 0x20;     // Differs from what the buffer holds now
+    check(write(p[1], pattern, sizeof(pattern)) == sizeof(pattern),
+          "fill pipe");
+    off = 0;
+    n = splice(p[0], NULL, fd, &off, sizeof(pattern), 0);
+    check(n == SPLICE_LEN && off == SPLICE_LEN,
+          "splice several pipe buffers into the device");
+    check(write(p[1], pattern, SPLICE_SKIP) == SPLICE_SKIP &&
+          splice(p[0], NULL, fd, &off, SPLICE_SKIP, 0) == SPLICE_SKIP &&
+          off == SPLICE_LEN + SPLICE_SKIP, "splice appends at the given offset");
+    memset(out, 0, sizeof(out));
+    n = pread(fd, out, sizeof(out), 0);
+    check(n == SPLICE_LEN && !memcmp(out, pattern, SPLICE_LEN),
+          "read back first splice");
+    n = pread(fd, out, sizeof(out), SPLICE_LEN);
+    check(n == SPLICE_SKIP && !memcmp(out, pattern, SPLICE_SKIP),
+          "read back appended splice");
+
+    check(ioctl(fd, _IO('c', 0x7f)) < 0 && errno == ENOTTY,
+          "unknown ioctl fails with ENOTTY");
+
+    close(p[0]);
+    close(p[1]);
+    close(fd);
+}
+
+static int record_offsets(int fd, __u32 *offsets, __u32 max) {
+    struct chardev_rec_offsets req = {
+        .max = max,
+        .offsets = (__u64)(unsigned long)offsets,
+    };
+
+    if (ioctl(fd, CHARDEV_GET_RECORD_OFFSETS, &req) < 0)
+        return -1;
+    return req.count;
+}
+
+static int write_record(int fd, char tag, size_t len) {
+    char buf[256];
+
+    memset(buf, tag, len);
+    return write(fd, buf, len) == (ssize_t)len ? 0 : -1;
+}
+
+/*
+ * Record mode: write boundaries survive, a read returns only whole
+ * records, and a record that does not fit stays queued.
+ */
+static void test_records(void) {
+    static const size_t lens[] = { 100, 120, 110 };
+    static char big[65536];
+    char buf[256];
+    __u32 offsets[8];
+    int fd, one = 1, i, ok;
+    ssize_t n;
+
+    printf("Record mode...\n");
+
+    fd = open(DEVICE_PATH, O_RDWR | O_NONBLOCK);
+    if (fd < 0 || ioctl(fd, CHARDEV_SET_RECORD_MODE, &one) < 0) {
+        perror("open/CHARDEV_SET_RECORD_MODE");
+        failures++;
+        return;
+    }
+
+    // Drop whatever an earlier run left in the ring
+    while (read(fd, big, sizeof(big)) > 0)
+        ;
+
+    check(write(fd, buf, 0) < 0 && errno == EINVAL, "empty record is rejected");
+
+    // No two of these fit in 150 bytes, so every read returns exactly one
+    ok = 1;
+    for (i = 0; i < 3; i++)
+        ok &= write_record(fd, 'A' + i, lens[i]) == 0;
+    check(ok, "write 3 records");
+    for (i = 0; i < 3; i++) {
+        char what[64];
+
+        n = read(fd, buf, 150);
+        snprintf(what, sizeof(what), "read %d returns record %d only", i, i);
+        check(n == (ssize_t)lens[i] && buf[0] == 'A' + i && buf[n - 1] == 'A' + i &&
+              record_offsets(fd, offsets, 8) == 1 && offsets[0] == 0, what);
+    }
+    check(read(fd, buf, sizeof(buf)) < 0 && errno == EAGAIN,
+          "empty ring returns EAGAIN");
+
+    // A big enough buffer takes all of them in one call
+    ok = 1;
+    for (i = 0; i < 3; i++)
+        ok &= write_record(fd, 'A' + i, lens[i]) == 0;
+    n = read(fd, big, sizeof(big));
+    check(ok && n == 330 && record_offsets(fd, offsets, 8) == 3 &&
+          offsets[0] == 0 && offsets[1] == 100 && offsets[2] == 220 &&
+          big[100] == 'B' && big[220] == 'C', "batched read returns 3 records");
+
+    // Too small for the head record: EMSGSIZE and nothing is consumed
+    check(write_record(fd, 'Z', 100) == 0, "write 100 byte record");
+    check(read(fd, buf, 50) < 0 && errno == EMSGSIZE,
+          "short buffer fails with EMSGSIZE");
+    n = read(fd, buf, 100);
+    check(n == 100 && buf[0] == 'Z', "record is still queued after EMSGSIZE");
+
+    close(fd);
+}
+
+int main(int argc, char *argv[]) {
+    int test_num = 0;
+
+    if (argc > 1)
+        test_num = atoi(argv[1]);
+
+    switch (test_num) {
+    case 0:
+        test_splice();
+        test_records();
+        break;
+
+    case 1:
+        test_splice();
+        break;
+
+    case 2:
+        test_records();
+        break;
+
+    default:
+        printf("Usage: %s [test_number]\n", argv[0]);
+        printf("  0 - All tests (default)\n");
+        printf("  1 - Splice to and from pipe\n");
+        printf("  2 - Record mode\n");
+        return 1;
+    }
+
+    printf("\n%s (%d failures)\n", failures ? "FAILED" : "PASSED", failures);
+    return failures ? 1 : 0;
+}
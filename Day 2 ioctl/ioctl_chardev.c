@@ -5,6 +5,21 @@
 #include <linux/uaccess.h>
 #include <linux/cdev.h>
 #include <linux/ioctl.h>
+#include <linux/percpu.h>
+#include <linux/ktime.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+#include <linux/slab.h>
+#include <linux/list.h>
+#include <linux/spinlock.h>
+#include <linux/poll.h>
+#include <linux/eventfd.h>
+#include <linux/version.h>
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(6, 8, 0)
+#include <linux/io_uring/cmd.h>
+#else
+#include <linux/io_uring.h>
+#endif
 
 #define DEVICE_NAME "ioctl_dev"
 #define MAGIC_NUM 'k'
@@ -14,35 +29,400 @@
 #define IOCTL_RESET_COUNTER _IO(MAGIC_NUM, 3)
 #define IOCTL_INCREMENT _IO(MAGIC_NUM, 4)
 
+#define COUNTER_WATCH_VALUE (1 << 0)  // Fire when counter >= value
+#define COUNTER_WATCH_DELTA (1 << 1)  // Fire when counter moved >= delta since last notify
+
+struct counter_watch {
+    __s32 value;
+    __u32 delta;
+    __s32 eventfd;   // eventfd to signal, or -1 to rely on poll() only
+    __u32 flags;     // COUNTER_WATCH_*
+};
+
+#define IOCTL_SET_WATCH _IOW(MAGIC_NUM, 5, struct counter_watch)
+#define IOCTL_CLEAR_WATCH _IO(MAGIC_NUM, 6)
+#define IOCTL_ACK_WATCH _IOR(MAGIC_NUM, 7, int)
+#define IOCTL_ADD_COUNTER _IOW(MAGIC_NUM, 8, int)
+
+/*
+ * io_uring passthrough: sqe->cmd_op is one of GET/SET/RESET/INCREMENT/
+ * ADD_COUNTER above, and the operand travels inline in the SQE instead of
+ * behind a user pointer. cqe->res is 0 or a negative errno; on rings set
+ * up with IORING_SETUP_CQE32 the counter value after the command is
+ * returned in cqe->big_cqe[0].
+ */
+struct counter_uring_cmd {
+    __s32 value;     // SET: new value, ADD: amount to add
+    __u32 pad;
+    __u64 reserved;
+};
+
 static dev_t dev_num;
 static struct cdev my_cdev;
-static int counter = 0;
+static atomic_t counter = ATOMIC_INIT(0);
 
-static long device_ioctl(struct file *file, unsigned int cmd, unsigned long arg) {
+/*
+ * One watch per open file. The value watch is edge triggered: it fires
+ * once when the counter reaches value and re-arms when it drops below it
+ * again. The delta watch fires once the counter has moved delta away from
+ * where it was at the last notification.
+ */
+struct watch_file {
+    struct list_head node;       // On watch_list while a watch is set
+    struct counter_watch req;
+    struct eventfd_ctx *efd;
+    bool value_armed;
+    int base;                    // Counter at the last notification
+    int notified;                // Counter value that fired, returned by ACK
+    bool pending;                // Notified and not yet acknowledged
+};
+
+static LIST_HEAD(watch_list);
+static DEFINE_SPINLOCK(watch_lock);
+static DECLARE_WAIT_QUEUE_HEAD(watch_wq);
+
+/*
+ * Lowest counter value at which any watch can fire. Increments below it
+ * skip watch_lock entirely, so a hot counter only pays for the checks when
+ * it actually crosses a threshold.
+ */
+static int watch_next = INT_MAX;
+
+/*
+ * Optional per-command timing for the benchmark suite. Counters are per-CPU
+ * so enabling them does not add a shared cache line to every ioctl.
+ */
+enum {
+    T_OPEN,
+    T_RELEASE,
+    T_GET_COUNTER,
+    T_SET_COUNTER,
+    T_RESET_COUNTER,
+    T_INCREMENT,
+    T_SET_WATCH,
+    T_CLEAR_WATCH,
+    T_ACK_WATCH,
+    T_ADD_COUNTER,
+    T_URING_CMD,
+    T_NR,
+};
+
+static const char * const timing_names[T_NR] = {
+    [T_OPEN] = "open",
+    [T_RELEASE] = "release",
+    [T_GET_COUNTER] = "get_counter",
+    [T_SET_COUNTER] = "set_counter",
+    [T_RESET_COUNTER] = "reset_counter",
+    [T_INCREMENT] = "increment",
+    [T_SET_WATCH] = "set_watch",
+    [T_CLEAR_WATCH] = "clear_watch",
+    [T_ACK_WATCH] = "ack_watch",
+    [T_ADD_COUNTER] = "add_counter",
+    [T_URING_CMD] = "uring_cmd",
+};
+
+struct op_timing {
+    u64 count[T_NR];
+    u64 ns[T_NR];
+};
+
+static DEFINE_PER_CPU(struct op_timing, op_timing);
+static struct dentry *debugfs_dir;
+
+static bool timing;
+module_param(timing, bool, 0644);
+MODULE_PARM_DESC(timing, "Record per-command kernel time in debugfs ioctl_dev/timing");
+
+static inline u64 timing_start(void) {
+    return READ_ONCE(timing) ? ktime_get_ns() : 0;
+}
+
+static inline void timing_end(int op, u64 t0) {
+    if (!t0)
+        return;
+    this_cpu_inc(op_timing.count[op]);
+    this_cpu_add(op_timing.ns[op], ktime_get_ns() - t0);
+}
+
+// "<op> <count> <total_ns>" per line; any write clears the counters
+static int timing_show(struct seq_file *s, void *unused) {
+    int op, cpu;
+    
+    for (op = 0; op < T_NR; op++) {
+        u64 count = 0, ns = 0;
+        
+        for_each_possible_cpu(cpu) {
+            count += per_cpu(op_timing, cpu).count[op];
+            ns += per_cpu(op_timing, cpu).ns[op];
+        }
+        seq_printf(s, "%s %llu %llu\n", timing_names[op], count, ns);
+    }
+    return 0;
+}
+
+static int timing_open(struct inode *inode, struct file *file) {
+    return single_open(file, timing_show, NULL);
+}
+
+static ssize_t timing_write(struct file *file, const char __user *buf,
+                            size_t count, loff_t *ppos) {
+    int cpu;
+    
+    for_each_possible_cpu(cpu)
+        memset(per_cpu_ptr(&op_timing, cpu), 0, sizeof(struct op_timing));
+    return count;
+}
+
+static const struct file_operations timing_fops = {
+    .owner = THIS_MODULE,
+    .open = timing_open,
+    .read = seq_read,
+    .write = timing_write,
+    .llseek = seq_lseek,
+    .release = single_release,
+};
+
+static int timing_op(unsigned int cmd) {
+    switch (cmd) {
+    case IOCTL_GET_COUNTER:
+        return T_GET_COUNTER;
+    case IOCTL_SET_COUNTER:
+        return T_SET_COUNTER;
+    case IOCTL_RESET_COUNTER:
+        return T_RESET_COUNTER;
+    case IOCTL_INCREMENT:
+        return T_INCREMENT;
+    case IOCTL_SET_WATCH:
+        return T_SET_WATCH;
+    case IOCTL_CLEAR_WATCH:
+        return T_CLEAR_WATCH;
+    case IOCTL_ACK_WATCH:
+        return T_ACK_WATCH;
+    case IOCTL_ADD_COUNTER:
+        return T_ADD_COUNTER;
+    default:
+        return -1;
+    }
+}
+
+static void watch_signal(struct eventfd_ctx *efd) {
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(6, 8, 0)
+    eventfd_signal(efd);
+#else
+    eventfd_signal(efd, 1);
+#endif
+}
+
+// Caller holds watch_lock
+static int watch_threshold(struct watch_file *wf) {
+    int next = INT_MAX;
+    
+    if (wf->value_armed)
+        next = wf->req.value;
+    if (wf->req.flags & COUNTER_WATCH_DELTA)
+        next = min_t(s64, next, (s64)wf->base + wf->req.delta);
+    return next;
+}
+
+// Caller holds watch_lock
+static void watch_update_next(void) {
+    struct watch_file *wf;
+    int next = INT_MAX;
+    
+    list_for_each_entry(wf, &watch_list, node)
+        next = min(next, watch_threshold(wf));
+    WRITE_ONCE(watch_next, next);
+    // Pairs with the full barrier in atomic_add_return() in counter_add()
+    smp_mb();
+}
+
+// Caller holds watch_lock
+static bool watch_check(struct watch_file *wf, int val) {
+    bool fire = false;
+    
+    if (wf->value_armed && val >= wf->req.value) {
+        wf->value_armed = false;
+        fire = true;
+    } else if ((wf->req.flags & COUNTER_WATCH_VALUE) && val < wf->req.value) {
+        wf->value_armed = true;
+    }
+    
+    if ((wf->req.flags & COUNTER_WATCH_DELTA) &&
+        abs((s64)val - wf->base) >= wf->req.delta)
+        fire = true;
+    
+    if (!fire)
+        return false;
+    
+    wf->base = val;
+    wf->notified = val;
+    // Eventfd and poll waiters get one notification until they acknowledge
+    if (wf->pending)
+        return false;
+    wf->pending = true;
+    if (wf->efd)
+        watch_signal(wf->efd);
+    return true;
+}
+
+/*
+ * The counter is re-read under watch_lock so that concurrent increments
+ * are seen in order and a stale value cannot re-arm a value watch.
+ */
+static void watch_check_all(void) {
+    struct watch_file *wf;
+    bool wake = false;
+    int val;
+    
+    spin_lock(&watch_lock);
+    val = atomic_read(&counter);
+    list_for_each_entry(wf, &watch_list, node)
+        wake |= watch_check(wf, val);
+    watch_update_next();
+    spin_unlock(&watch_lock);
+    
+    if (wake)
+        wake_up_interruptible_poll(&watch_wq, EPOLLIN | EPOLLPRI);
+}
+
+/*
+ * SET and RESET can move the counter anywhere, so they rebase the delta
+ * watches and re-arm value watches the counter has dropped below.
+ */
+static void watch_rebase_all(int val) {
+    struct watch_file *wf;
+    
+    spin_lock(&watch_lock);
+    list_for_each_entry(wf, &watch_list, node)
+        wf->base = val;
+    spin_unlock(&watch_lock);
+    watch_check_all();
+}
+
+static void counter_changed(int val) {
+    if (val >= READ_ONCE(watch_next))
+        watch_check_all();
+}
+
+static int watch_set(struct watch_file *wf, struct counter_watch __user *arg) {
+    struct counter_watch req;
+    struct eventfd_ctx *efd = NULL, *old;
+    
+    if (copy_from_user(&req, arg, sizeof(req)))
+        return -EFAULT;
+    if (!req.flags || (req.flags & ~(COUNTER_WATCH_VALUE | COUNTER_WATCH_DELTA)))
+        return -EINVAL;
+    if ((req.flags & COUNTER_WATCH_DELTA) && !req.delta)
+        return -EINVAL;
+    
+    if (req.eventfd >= 0) {
+        efd = eventfd_ctx_fdget(req.eventfd);
+        if (IS_ERR(efd))
+            return PTR_ERR(efd);
+    }
+    
+    spin_lock(&watch_lock);
+    old = wf->efd;
+    wf->req = req;
+    wf->efd = efd;
+    wf->value_armed = req.flags & COUNTER_WATCH_VALUE;
+    wf->base = atomic_read(&counter);
+    wf->pending = false;
+    if (list_empty(&wf->node))
+        list_add(&wf->node, &watch_list);
+    watch_update_next();
+    spin_unlock(&watch_lock);
+    
+    if (old)
+        eventfd_ctx_put(old);
+    
+    // A value watch that is already met fires right away
+    watch_check_all();
+    return 0;
+}
+
+static void watch_clear(struct watch_file *wf) {
+    struct eventfd_ctx *old;
+    
+    spin_lock(&watch_lock);
+    list_del_init(&wf->node);
+    old = wf->efd;
+    wf->efd = NULL;
+    wf->pending = false;
+    watch_update_next();
+    spin_unlock(&watch_lock);
+    
+    if (old)
+        eventfd_ctx_put(old);
+}
+
+/* Counter updates shared by the ioctl and io_uring paths */
+static void counter_set(int val) {
+    atomic_set(&counter, val);
+    watch_rebase_all(val);
+}
+
+static int counter_add(int n) {
+    int val = atomic_add_return(n, &counter);
+    
+    // Moving down can re-arm value watches, so take the full check
+    if (n < 0)
+        watch_check_all();
+    else
+        counter_changed(val);
+    return val;
+}
+
+static long counter_ioctl(struct file *file, unsigned int cmd, unsigned long arg) {
+    struct watch_file *wf = file->private_data;
     int temp;
     
     switch (cmd) {
     case IOCTL_GET_COUNTER:
-        if (copy_to_user((int __user *)arg, &counter, sizeof(int)))
+        temp = atomic_read(&counter);
+        if (copy_to_user((int __user *)arg, &temp, sizeof(int)))
             return -EFAULT;
-        pr_info("IOCTL_GET_COUNTER: %d\n", counter);
+        pr_debug("IOCTL_GET_COUNTER: %d\n", temp);
         break;
         
     case IOCTL_SET_COUNTER:
         if (copy_from_user(&temp, (int __user *)arg, sizeof(int)))
             return -EFAULT;
-        counter = temp;
-        pr_info("IOCTL_SET_COUNTER: %d\n", counter);
+        counter_set(temp);
+        pr_debug("IOCTL_SET_COUNTER: %d\n", temp);
         break;
         
     case IOCTL_RESET_COUNTER:
-        counter = 0;
-        pr_info("IOCTL_RESET_COUNTER\n");
+        counter_set(0);
+        pr_debug("IOCTL_RESET_COUNTER\n");
         break;
         
     case IOCTL_INCREMENT:
-        counter++;
-        pr_info("IOCTL_INCREMENT: %d\n", counter);
+        temp = counter_add(1);
+        pr_debug("IOCTL_INCREMENT: %d\n", temp);
+        break;
+        
+    case IOCTL_ADD_COUNTER:
+        if (copy_from_user(&temp, (int __user *)arg, sizeof(int)))
+            return -EFAULT;
+        temp = counter_add(temp);
+        pr_debug("IOCTL_ADD_COUNTER: %d\n", temp);
+        break;
+        
+    case IOCTL_SET_WATCH:
+        return watch_set(wf, (struct counter_watch __user *)arg);
+        
+    case IOCTL_CLEAR_WATCH:
+        watch_clear(wf);
+        break;
+        
+    case IOCTL_ACK_WATCH:
+        spin_lock(&watch_lock);
+        temp = wf->notified;
+        wf->pending = false;
+        spin_unlock(&watch_lock);
+        if (copy_to_user((int __user *)arg, &temp, sizeof(int)))
+            return -EFAULT;
         break;
         
     default:
@@ -52,13 +432,103 @@ static long device_ioctl(struct file *file, unsigned int cmd, unsigned long arg)
     return 0;
 }
 
+/*
+ * Commands complete inline, so an SQPOLL ring updates the counter without
+ * the submitter entering the kernel. The status goes in cqe->res and the
+ * resulting value in the second CQE word, which only CQE32 rings have;
+ * GET is refused on other rings since it would have nothing to return.
+ */
+static int device_uring_cmd(struct io_uring_cmd *ioucmd, unsigned int issue_flags) {
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(6, 5, 0)
+    const struct counter_uring_cmd *cmd = io_uring_sqe_cmd(ioucmd->sqe);
+#else
+    const struct counter_uring_cmd *cmd = ioucmd->cmd;
+#endif
+    bool cqe32 = issue_flags & IO_URING_F_CQE32;
+    u64 t0 = timing_start();
+    int val, ret = 0;
+    
+    switch (ioucmd->cmd_op) {
+    case IOCTL_GET_COUNTER:
+        if (!cqe32) {
+            ret = -EINVAL;
+            goto out;
+        }
+        val = atomic_read(&counter);
+        break;
+    case IOCTL_SET_COUNTER:
+        val = READ_ONCE(cmd->value);
+        counter_set(val);
+        break;
+    case IOCTL_RESET_COUNTER:
+        val = 0;
+        counter_set(0);
+        break;
+    case IOCTL_INCREMENT:
+        val = counter_add(1);
+        break;
+    case IOCTL_ADD_COUNTER:
+        val = counter_add(READ_ONCE(cmd->value));
+        break;
+    default:
+        ret = -EINVAL;
+        goto out;
+    }
+    
+    if (cqe32) {
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(6, 3, 0)
+        io_uring_cmd_done(ioucmd, 0, val, issue_flags);
+#else
+        io_uring_cmd_done(ioucmd, 0, val);
+#endif
+        ret = -EIOCBQUEUED;
+    }
+out:
+    timing_end(T_URING_CMD, t0);
+    return ret;
+}
+
+static __poll_t device_poll(struct file *file, poll_table *wait) {
+    struct watch_file *wf = file->private_data;
+    
+    poll_wait(file, &watch_wq, wait);
+    return READ_ONCE(wf->pending) ? EPOLLIN | EPOLLRDNORM | EPOLLPRI : 0;
+}
+
+static long device_ioctl(struct file *file, unsigned int cmd, unsigned long arg) {
+    u64 t0 = timing_start();
+    long ret = counter_ioctl(file, cmd, arg);
+    int op = timing_op(cmd);
+    
+    if (op >= 0)
+        timing_end(op, t0);
+    return ret;
+}
+
 static int device_open(struct inode *inode, struct file *file) {
-    pr_info("Device opened\n");
+    u64 t0 = timing_start();
+    struct watch_file *wf;
+    
+    wf = kzalloc(sizeof(*wf), GFP_KERNEL);
+    if (!wf)
+        return -ENOMEM;
+    INIT_LIST_HEAD(&wf->node);
+    file->private_data = wf;
+    
+    pr_debug("Device opened\n");
+    timing_end(T_OPEN, t0);
     return 0;
 }
 
 static int device_release(struct inode *inode, struct file *file) {
-    pr_info("Device closed\n");
+    u64 t0 = timing_start();
+    struct watch_file *wf = file->private_data;
+    
+    watch_clear(wf);
+    kfree(wf);
+    
+    pr_debug("Device closed\n");
+    timing_end(T_RELEASE, t0);
     return 0;
 }
 
@@ -67,6 +537,8 @@ static struct file_operations fops = {
     .open = device_open,
     .release = device_release,
     .unlocked_ioctl = device_ioctl,
+    .poll = device_poll,
+    .uring_cmd = device_uring_cmd,
 };
 
 static int __init ioctl_init(void) {
@@ -83,11 +555,15 @@ static int __init ioctl_init(void) {
         return ret;
     }
     
+    debugfs_dir = debugfs_create_dir(DEVICE_NAME, NULL);
+    debugfs_create_file("timing", 0600, debugfs_dir, NULL, &timing_fops);
+    
     pr_info("%s: Registered (Major: %d)\n", DEVICE_NAME, MAJOR(dev_num));
     return 0;
 }
 
 static void __exit ioctl_exit(void) {
+    debugfs_remove_recursive(debugfs_dir);
     cdev_del(&my_cdev);
     unregister_chrdev_region(dev_num, 1);
     pr_info("%s: Unregistered\n", DEVICE_NAME);
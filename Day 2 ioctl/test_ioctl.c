@@ -1,7 +1,11 @@
 #include <stdio.h>
 #include <fcntl.h>
 #include <unistd.h>
+#include <stdint.h>
+#include <poll.h>
 #include <sys/ioctl.h>
+#include <sys/eventfd.h>
+#include <linux/types.h>
 
 #define MAGIC_NUM 'k'
 #define IOCTL_GET_COUNTER _IOR(MAGIC_NUM, 1, int)
@@ -9,8 +13,25 @@
 #define IOCTL_RESET_COUNTER _IO(MAGIC_NUM, 3)
 #define IOCTL_INCREMENT _IO(MAGIC_NUM, 4)
 
+#define COUNTER_WATCH_VALUE (1 << 0)
+#define COUNTER_WATCH_DELTA (1 << 1)
+
+struct counter_watch {
+    __s32 value;
+    __u32 delta;
+    __s32 eventfd;
+    __u32 flags;
+};
+
+#define IOCTL_SET_WATCH _IOW(MAGIC_NUM, 5, struct counter_watch)
+#define IOCTL_CLEAR_WATCH _IO(MAGIC_NUM, 6)
+#define IOCTL_ACK_WATCH _IOR(MAGIC_NUM, 7, int)
+
 int main() {
-    int fd, value;
+    int fd, efd, value, i;
+    struct counter_watch watch;
+    struct pollfd pfd;
+    uint64_t events;
     
     fd = open("/dev/ioctl_dev", O_RDWR);
     if (fd < 0) {
@@ -36,6 +57,47 @@ int main() {
     ioctl(fd, IOCTL_GET_COUNTER, &value);
     printf("After reset: %d\n", value);
     
+    // Watermark: eventfd fires once the counter reaches 3
+    efd = eventfd(0, EFD_NONBLOCK);
+    watch.value = 3;
+    watch.delta = 0;
+    watch.eventfd = efd;
+    watch.flags = COUNTER_WATCH_VALUE;
+    if (ioctl(fd, IOCTL_SET_WATCH, &watch) < 0)
+        perror("IOCTL_SET_WATCH");
+    for (i = 0; i < 5; i++)
+        ioctl(fd, IOCTL_INCREMENT);
+    if (read(efd, &events, sizeof(events)) == sizeof(events))
+        printf("eventfd notifications: %llu\n", (unsigned long long)events);
+    
+    // Same watch seen through poll() on the device itself
+    pfd.fd = fd;
+    pfd.events = POLLIN;
+    if (poll(&pfd, 1, 0) > 0 && (pfd.revents & POLLIN)) {
+        ioctl(fd, IOCTL_ACK_WATCH, &value);
+        printf("poll: notified at %d\n", value);
+    }
+    
+    ioctl(fd, IOCTL_CLEAR_WATCH);
+    
+    // Delta watch: five firings before an ACK signal the eventfd once
+    watch.value = 0;
+    watch.delta = 1;
+    watch.flags = COUNTER_WATCH_DELTA;
+    if (ioctl(fd, IOCTL_SET_WATCH, &watch) < 0)
+        perror("IOCTL_SET_WATCH");
+    for (i = 0; i < 5; i++)
+        ioctl(fd, IOCTL_INCREMENT);
+    if (read(efd, &events, sizeof(events)) == sizeof(events))
+        printf("eventfd notifications before ack: %llu\n",
+               (unsigned long long)events);
+    ioctl(fd, IOCTL_ACK_WATCH, &value);
+    printf("ack: notified at %d\n", value);
+    
+    ioctl(fd, IOCTL_CLEAR_WATCH);
+    close(efd);
+    ioctl(fd, IOCTL_RESET_COUNTER);
+    
     close(fd);
     return 0;
 }
\ No newline at end of file
@@ -0,0 +1,227 @@
+// test_uring.c - drive ioctl_dev counter commands through io_uring (SQPOLL)
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+
+#define MAGIC_NUM 'k'
+#define IOCTL_GET_COUNTER _IOR(MAGIC_NUM, 1, int)
+#define IOCTL_SET_COUNTER _IOW(MAGIC_NUM, 2, int)
+#define IOCTL_RESET_COUNTER _IO(MAGIC_NUM, 3)
+#define IOCTL_INCREMENT _IO(MAGIC_NUM, 4)
+#define IOCTL_ADD_COUNTER _IOW(MAGIC_NUM, 8, int)
+
+struct counter_uring_cmd {
+    __s32 value;
+    __u32 pad;
+    __u64 reserved;
+};
+
+/*
+ * CQE layout of an IORING_SETUP_CQE32 ring: the driver puts the counter
+ * value in the first extra word.
+ */
+struct counter_cqe {
+    __u64 user_data;
+    __s32 res;
+    __u32 flags;
+    __u64 big_cqe[2];
+};
+
+#define RING_ENTRIES 8
+#define REAP_TIMEOUT_NS 1000000000LL
+
+struct ring {
+    int fd;
+    unsigned *sq_head, *sq_tail, *sq_mask, *sq_flags, *sq_array;
+    unsigned *cq_head, *cq_tail, *cq_mask;
+    struct io_uring_sqe *sqes;
+    struct counter_cqe *cqes;
+};
+
+static int ring_init(struct ring *r, int sqpoll) {
+    struct io_uring_params p;
+    void *sq, *cq;
+    size_t sq_len, cq_len;
+
+    memset(&p, 0, sizeof(p));
+    p.flags = IORING_SETUP_CQE32;
+    if (sqpoll) {
+        p.flags |= IORING_SETUP_SQPOLL;
+        p.sq_thread_idle = 2000;
+    }
+    r->fd = syscall(__NR_io_uring_setup, RING_ENTRIES, &p);
+    if (r->fd < 0)
+        return -1;
+
+    sq_len = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+    cq_len = p.cq_off.cqes + p.cq_entries * sizeof(struct counter_cqe);
+    if (p.features & IORING_FEAT_SINGLE_MMAP)
+        sq_len = cq_len = sq_len > cq_len ? sq_len : cq_len;
+
+    sq = mmap(NULL, sq_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+              r->fd, IORING_OFF_SQ_RING);
+    if (sq == MAP_FAILED)
+        return -1;
+    cq = sq;
+    if (!(p.features & IORING_FEAT_SINGLE_MMAP)) {
+        cq = mmap(NULL, cq_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                  r->fd, IORING_OFF_CQ_RING);
+        if (cq == MAP_FAILED)
+            return -1;
+    }
+    r->sqes = mmap(NULL, p.sq_entries * sizeof(struct io_uring_sqe),
+                   PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                   r->fd, IORING_OFF_SQES);
+    if (r->sqes == MAP_FAILED)
+        return -1;
+
+    r->sq_head = sq + p.sq_off.head;
+    r->sq_tail = sq + p.sq_off.tail;
+    r->sq_mask = sq + p.sq_off.ring_mask;
+    r->sq_flags = sq + p.sq_off.flags;
+    r->sq_array = sq + p.sq_off.array;
+    r->cq_head = cq + p.cq_off.head;
+    r->cq_tail = cq + p.cq_off.tail;
+    r->cq_mask = cq + p.cq_off.ring_mask;
+    r->cqes = cq + p.cq_off.cqes;
+    return 0;
+}
+
+// Queue one counter command; linked so the commands run in order
+static void queue_cmd(struct ring *r, int dev_fd, unsigned cmd_op, int value,
+                      uint64_t user_data, int link) {
+    unsigned tail = *r->sq_tail;
+    unsigned idx = tail & *r->sq_mask;
+    struct io_uring_sqe *sqe = &r->sqes[idx];
+    struct counter_uring_cmd cmd = { .value = value };
+
+    memset(sqe, 0, sizeof(*sqe));
+    sqe->opcode = IORING_OP_URING_CMD;
+    sqe->fd = dev_fd;
+    sqe->cmd_op = cmd_op;
+    sqe->user_data = user_data;
+    if (link)
+        sqe->flags = IOSQE_IO_LINK;
+    memcpy(sqe->cmd, &cmd, sizeof(cmd));
+
+    r->sq_array[idx] = idx;
+    __atomic_store_n(r->sq_tail, tail + 1, __ATOMIC_RELEASE);
+}
+
+static int submit(struct ring *r, int sqpoll, unsigned count) {
+    unsigned flags = 0;
+
+    if (sqpoll) {
+        // The poller picks the SQEs up on its own unless it went idle
+        if (!(__atomic_load_n(r->sq_flags, __ATOMIC_ACQUIRE) & IORING_SQ_NEED_WAKEUP))
+            return 0;
+        flags = IORING_ENTER_SQ_WAKEUP;
+        count = 0;
+    }
+    return syscall(__NR_io_uring_enter, r->fd, count, 0, flags, NULL, 0);
+}
+
+static long long now_ns(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static int reap(struct ring *r, struct counter_cqe *out) {
+    unsigned head = *r->cq_head;
+    long long deadline = now_ns() + REAP_TIMEOUT_NS;
+
+    // No syscall on the completion side either: spin on the CQ tail
+    while (head == __atomic_load_n(r->cq_tail, __ATOMIC_ACQUIRE)) {
+        if (now_ns() > deadline)
+            return -1;
+    }
+    *out = r->cqes[head & *r->cq_mask];
+    __atomic_store_n(r->cq_head, head + 1, __ATOMIC_RELEASE);
+    return 0;
+}
+
+int main() {
+    static const struct {
+        const char *name;
+        unsigned cmd_op;
+        int value;
+        int expect;      // Counter value after the command
+    } cmds[] = {
+        { "SET 100", IOCTL_SET_COUNTER, 100, 100 },
+        { "INCREMENT", IOCTL_INCREMENT, 0, 101 },
+        { "INCREMENT", IOCTL_INCREMENT, 0, 102 },
+        { "ADD 10", IOCTL_ADD_COUNTER, 10, 112 },
+        { "GET", IOCTL_GET_COUNTER, 0, 112 },
+        { "ADD -5000", IOCTL_ADD_COUNTER, -5000, -4888 },
+        { "RESET", IOCTL_RESET_COUNTER, 0, 0 },
+    };
+    unsigned i, n = sizeof(cmds) / sizeof(cmds[0]);
+    struct counter_cqe cqe;
+    struct ring r;
+    int fd, sqpoll = 1, failures = 0;
+
+    fd = open("/dev/ioctl_dev", O_RDWR);
+    if (fd < 0) {
+        perror("Failed to open device");
+        return -1;
+    }
+
+    if (ring_init(&r, 1) < 0) {
+        perror("SQPOLL ring setup failed, falling back to io_uring_enter");
+        sqpoll = 0;
+        if (ring_init(&r, 0) < 0) {
+            perror("io_uring_setup");
+            return -1;
+        }
+    }
+
+    for (i = 0; i < n; i++)
+        queue_cmd(&r, fd, cmds[i].cmd_op, cmds[i].value, i, i < n - 1);
+    if (submit(&r, sqpoll, n) < 0) {
+        perror("io_uring_enter");
+        return -1;
+    }
+
+    for (i = 0; i < n; i++) {
+        int value, expect;
+
+        if (reap(&r, &cqe) < 0) {
+            printf("Timed out waiting for completion %u of %u\n", i + 1, n);
+            failures += n - i;
+            break;
+        }
+        if (cqe.user_data >= n) {
+            printf("Unexpected user_data %llu\n", (unsigned long long)cqe.user_data);
+            failures++;
+            continue;
+        }
+
+        value = (int)cqe.big_cqe[0];
+        expect = cmds[cqe.user_data].expect;
+        if (cqe.res < 0) {
+            printf("%-10s -> error %s\n", cmds[cqe.user_data].name,
+                   strerror(-cqe.res));
+            failures++;
+        } else if (value != expect) {
+            printf("%-10s -> counter %d, expected %d\n",
+                   cmds[cqe.user_data].name, value, expect);
+            failures++;
+        } else {
+            printf("%-10s -> counter %d\n", cmds[cqe.user_data].name, value);
+        }
+    }
+
+    printf("%s (%d failures)\n", failures ? "FAILED" : "PASSED", failures);
+    close(r.fd);
+    close(fd);
+    return failures ? 1 : 0;
+}
@@ -6,6 +6,24 @@
 #include <linux/dma-mapping.h>
 #include <linux/uaccess.h>
 #include <linux/vmalloc.h>
+#include <linux/mm.h>
+#include <linux/huge_mm.h>
+#include <linux/pfn_t.h>
+#include <linux/version.h>
+#include <linux/miscdevice.h>
+#include <linux/mutex.h>
+#include <linux/slab.h>
+#include <linux/hashtable.h>
+#include <linux/jhash.h>
+#include <linux/spinlock.h>
+#include <linux/printk.h>
+#include <linux/kref.h>
+#include <linux/rwsem.h>
+#include <linux/wait.h>
+#include <linux/poll.h>
+#include <linux/workqueue.h>
+#include <linux/jiffies.h>
+#include <asm/unaligned.h>
 
 #define DRIVER_NAME "simple_fb"
 #define FB_WIDTH  800
@@ -13,12 +31,144 @@
 #define FB_BPP    32  // Bits per pixel
 #define FB_DEPTH  24  // Color depth
 
+// Huge page mode backs the buffer with PMD-sized chunks (2 MiB on x86-64)
+#define FB_HUGE_ORDER (PMD_SHIFT - PAGE_SHIFT)
+
+static bool hugepage;
+module_param(hugepage, bool, 0444);
+MODULE_PARM_DESC(hugepage, "Back the framebuffer with PMD-sized pages and map them with huge PMD entries");
+
+/*
+ * fbcon only scrolls through fb_copyarea before 5.11, when accelerated
+ * scrolling was removed, and with CONFIG_FRAMEBUFFER_CONSOLE_LEGACY_ACCELERATION
+ * once it came back. Everywhere else it redraws, so the pan path would
+ * never run and the extra screens are only useful to FBIOPAN_DISPLAY users.
+ */
+#if LINUX_VERSION_CODE < KERNEL_VERSION(5, 11, 0) || \
+    IS_ENABLED(CONFIG_FRAMEBUFFER_CONSOLE_LEGACY_ACCELERATION)
+#define FBCON_SCROLLS_WITH_COPYAREA 1
+#else
+#define FBCON_SCROLLS_WITH_COPYAREA 0
+#endif
+
+static unsigned int virt_screens = FBCON_SCROLLS_WITH_COPYAREA ? 2 : 1;
+module_param(virt_screens, uint, 0444);
+MODULE_PARM_DESC(virt_screens, "Virtual height in screens (yres_virtual = yres * N, 1-8); above 1, console scrolls pan instead of copying when fbcon uses copyarea");
+
+#define FB_MAX_VIRT_SCREENS 8
+// Widest console font fbcon can blit
+#define SCROLL_MAX_FONT_W   32
+
+static unsigned int keyframe_interval;
+module_param(keyframe_interval, uint, 0644);
+MODULE_PARM_DESC(keyframe_interval, "Frames between forced keyframes on the stream device (0: first frame only)");
+
+/*
+ * Compressed frame stream, /dev/simple_fb_stream. Each read() returns the
+ * next piece of a frame: a header followed by tile ops over the visible
+ * window, cut into 64-byte tiles. Every op is a u32 with the op in the top
+ * two bits and a tile count in the rest. The header, op words and pixels
+ * are all little-endian.
+ */
+#define FBSTREAM_MAGIC      0x53424653  // "SFBS"
+#define FBSTREAM_TILE       64
+#define FBSTREAM_KEYFRAME   1
+#define FBSTREAM_DELTA      2
+
+#define FBSTREAM_OP_SKIP    0  // Tiles unchanged since the previous frame
+#define FBSTREAM_OP_FILL    1  // Tiles of one repeated 4-byte pixel, which follows
+#define FBSTREAM_OP_RAW     2  // Literal tiles follow, 64 bytes each
+#define FBSTREAM_OP_SHIFT   30
+#define FBSTREAM_MAX_COUNT  ((1U << FBSTREAM_OP_SHIFT) - 1)
+
+// Worst case per tile: a one-tile RAW op between FILLs
+#define FBSTREAM_MAX_TILE_BYTES (4 + FBSTREAM_TILE)
+
+// Drawing through mmap() is not seen by the driver; readers look this often
+#define FBSTREAM_RECHECK    msecs_to_jiffies(40)
+
+struct fbstream_hdr {
+    __le32 magic;
+    __le16 type;          // FBSTREAM_KEYFRAME or FBSTREAM_DELTA
+    __le16 tile_size;
+    __le32 seq;
+    __le32 xres;
+    __le32 yres;
+    __le32 bits_per_pixel;
+    __le32 line_length;
+    __le32 frame_len;     // Bytes covered by the tiles, line_length * yres rounded up
+    __le32 payload_len;   // Bytes of tile ops after this header
+};
+
+#define FBSTREAM_IOC_KEYFRAME _IO('S', 1)  // Make the next frame a keyframe
+
+/*
+ * Shared by the device and its open stream fds, and freed by the last of
+ * them. Remove clears info under the write lock, so an fd that outlives
+ * the device fails its reads instead of touching freed memory.
+ */
+struct fbstream_dev {
+    struct kref ref;
+    struct rw_semaphore lock;   // Read-held while encoding
+    struct fb_info *info;       // NULL once the device is removed
+    wait_queue_head_t wait;     // Readers waiting for the frame to change
+    unsigned long damage;       // Bumped after every drawing op
+};
+
+/*
+ * Glyph cache for imageblit. Console text arrives as 1-bpp bitmaps; each
+ * 8-pixel-wide column of one (a whole glyph for 8xN fonts) is expanded
+ * once per (bitmap, fg, bg, bpp) and then drawn with row copies.
+ */
+#define GLYPH_CELL_W     8
+#define GLYPH_MAX_H      32
+#define GLYPH_HASH_BITS  9
+
+static unsigned int glyph_cache_size = 512;
+module_param(glyph_cache_size, uint, 0444);
+MODULE_PARM_DESC(glyph_cache_size, "Expanded glyph cells kept in the LRU cache (0 disables it)");
+
+struct glyph_entry {
+    struct hlist_node hnode;
+    struct list_head lru;
+    u32 fg;                // Pixel values, already through the palette
+    u32 bg;
+    u8 bpp;
+    u8 height;
+    u8 bits[GLYPH_MAX_H];  // One bitmap byte per row
+    u8 pixels[GLYPH_CELL_W * GLYPH_MAX_H * 4];
+};
+
+struct glyph_cache {
+    spinlock_t lock;
+    DECLARE_HASHTABLE(table, GLYPH_HASH_BITS);
+    struct list_head lru;       // Most recently used first
+    struct glyph_entry *pool;   // Preallocated, so blits never allocate
+    unsigned int size;
+    unsigned int nr_used;
+    unsigned long hits;
+    unsigned long misses;
+};
+
 struct simple_fb_par {
     u32 pseudo_palette[16];
     struct platform_device *pdev;
     void *fb_virt;       // Virtual address of framebuffer
     dma_addr_t fb_phys;  // Physical address
     size_t fb_size;
+    struct page **huge_pages;  // Huge page mode: one PMD-sized chunk per entry
+    unsigned int nr_huge;
+    struct miscdevice stream;  // Compressed frame export
+    struct fbstream_dev *stream_dev;
+    struct glyph_cache glyphs;
+    /*
+     * Scanout origin in rows, mirrored in var.yoffset. Console drawing
+     * arrives in screen coordinates and is shifted by it, so a scroll can
+     * move the origin instead of the pixels.
+     */
+    u32 scroll_y;
+    unsigned long scroll_pans;
+    unsigned long scroll_wraps;
 };
 
 static struct fb_var_screeninfo simple_fb_var = {
@@ -43,6 +193,7 @@ static struct fb_fix_screeninfo simple_fb_fix = {
     .visual         = FB_VISUAL_TRUECOLOR,
     .accel          = FB_ACCEL_NONE,
     .line_length    = FB_WIDTH * (FB_BPP / 8),
+    .ypanstep       = 1,
 };
 
 /*
@@ -51,6 +202,8 @@ static struct fb_fix_screeninfo simple_fb_fix = {
 
 static int simple_fb_check_var(struct fb_var_screeninfo *var, struct fb_info *info)
 {
+    struct simple_fb_par *par = info->par;
+    
     pr_info("%s: Checking var\n", DRIVER_NAME);
     
     // Validate resolution
@@ -94,14 +247,53 @@ static int simple_fb_check_var(struct fb_var_screeninfo *var, struct fb_info *in
         break;
     }
     
+    // The virtual area has to fit the memory allocated at probe
+    if (var->xres_virtual < var->xres)
+        var->xres_virtual = var->xres;
+    if (var->yres_virtual < var->yres)
+        var->yres_virtual = var->yres;
+    if ((size_t)var->xres_virtual * (var->bits_per_pixel / 8) *
+        var->yres_virtual > par->fb_size) {
+        pr_err("Virtual resolution too large: %dx%d\n",
+               var->xres_virtual, var->yres_virtual);
+        return -EINVAL;
+    }
+    
+    /*
+     * set_par takes yoffset as the drawing origin and the sys_* helpers
+     * do not clip, so keep the visible window inside the virtual area.
+     */
+    if (var->xoffset > var->xres_virtual - var->xres)
+        var->xoffset = var->xres_virtual - var->xres;
+    if (var->yoffset > var->yres_virtual - var->yres)
+        var->yoffset = var->yres_virtual - var->yres;
+    
     return 0;
 }
 
+/*
+ * Tell stream readers the frame changed. Called after the drawing, and
+ * the release pairs with the acquire in fbstream_next(), so a reader that
+ * sees the new count also sees the pixels.
+ */
+static void simple_fb_damage(struct simple_fb_par *par)
+{
+    struct fbstream_dev *sd = par->stream_dev;
+    
+    smp_store_release(&sd->damage, sd->damage + 1);
+    if (wq_has_sleeper(&sd->wait))
+        wake_up_interruptible_poll(&sd->wait, EPOLLIN | EPOLLRDNORM);
+}
+
 static int simple_fb_set_par(struct fb_info *info)
 {
+    struct simple_fb_par *par = info->par;
+    
     pr_info("%s: Setting par\n", DRIVER_NAME);
     
-    info->fix.line_length = info->var.xres * (info->var.bits_per_pixel / 8);
+    info->fix.line_length = info->var.xres_virtual * (info->var.bits_per_pixel / 8);
+    par->scroll_y = info->var.yoffset;
+    simple_fb_damage(par);
     
     return 0;
 }
@@ -164,13 +356,17 @@ static int simple_fb_blank(int blank_mode, struct fb_info *info)
 static int simple_fb_pan_display(struct fb_var_screeninfo *var,
                                  struct fb_info *info)
 {
-    if (var->xoffset + info->var.xres > info->var.xres_virtual ||
-        var->yoffset + info->var.yres > info->var.yres_virtual)
+    // Written so that a huge offset cannot wrap around and pass
+    if (var->xoffset > info->var.xres_virtual - info->var.xres ||
+        var->yoffset > info->var.yres_virtual - info->var.yres)
         return -EINVAL;
     
     pr_info("Pan display: xoffset=%d, yoffset=%d\n",
             var->xoffset, var->yoffset);
     
+    ((struct simple_fb_par *)info->par)->scroll_y = var->yoffset;
+    simple_fb_damage(info->par);
+    
     return 0;
 }
 
@@ -178,36 +374,347 @@ static int simple_fb_pan_display(struct fb_var_screeninfo *var,
 static void simple_fb_fillrect(struct fb_info *info,
                                const struct fb_fillrect *rect)
 {
+    struct simple_fb_par *par = info->par;
+    struct fb_fillrect r = *rect;
+    
     pr_debug("fillrect: x=%d, y=%d, width=%d, height=%d, color=0x%x\n",
              rect->dx, rect->dy, rect->width, rect->height, rect->color);
     
     // Use software fallback
-    sys_fillrect(info, rect);
+    r.dy += par->scroll_y;
+    sys_fillrect(info, &r);
+    simple_fb_damage(par);
+}
+
+static void simple_fb_move_rows(struct fb_info *info, u32 dst, u32 src, u32 rows)
+{
+    struct simple_fb_par *par = info->par;
+    u32 line = info->fix.line_length;
+    
+    memmove((u8 *)par->fb_virt + (size_t)dst * line,
+            (u8 *)par->fb_virt + (size_t)src * line, (size_t)rows * line);
+}
+
+static void simple_fb_set_scroll(struct fb_info *info, u32 origin)
+{
+    struct simple_fb_par *par = info->par;
+    
+    par->scroll_y = origin;
+    info->var.yoffset = origin;
+}
+
+/*
+ * fbcon copies whole character cells, so its full-width copies stop short
+ * of xres by less than one font width. Accept width if some font width
+ * wider than that gap divides it.
+ */
+static bool simple_fb_full_width(struct fb_info *info, u32 width)
+{
+    u32 gap, fw;
+    
+    if (!width || width > info->var.xres)
+        return false;
+    
+    gap = info->var.xres - width;
+    for (fw = gap + 1; fw <= SCROLL_MAX_FONT_W; fw++)
+        if (width % fw == 0)
+            return true;
+    return false;
+}
+
+/*
+ * Turn a full-width vertical scroll into a pan. For a scroll up by n
+ * rows (sy = n, dy = 0) the origin moves down n rows, and only the rows
+ * the copy does not cover (the new bottom line and any margin) are copied
+ * back into place. When the origin would run off the end of the virtual
+ * area, the screen is moved back to the top of the buffer in one copy.
+ * A scroll down pans the other way when there is room above the origin.
+ */
+static bool simple_fb_copyarea_pan(struct fb_info *info,
+                                   const struct fb_copyarea *area)
+{
+    struct simple_fb_par *par = info->par;
+    u32 yres = info->var.yres;
+    u32 vyres = info->var.yres_virtual;
+    u32 origin = par->scroll_y;
+    u32 h = area->height;
+    u32 n;
+    
+    if (vyres <= yres || area->sx || area->dx ||
+        !simple_fb_full_width(info, area->width))
+        return false;
+    // Small copies are cheaper done directly
+    if (h < yres / 2 || area->sy == area->dy)
+        return false;
+    
+    if (area->sy > area->dy) {
+        n = area->sy - area->dy;
+        if (area->dy || area->sy + h > yres)
+            return false;
+        
+        if (origin + n + yres <= vyres) {
+            // Rows [h, yres) keep their old contents
+            simple_fb_move_rows(info, origin + n + h, origin + h, yres - h);
+            simple_fb_set_scroll(info, origin + n);
+            par->scroll_pans++;
+        } else {
+            simple_fb_move_rows(info, 0, origin + n, h);
+            simple_fb_move_rows(info, h, origin + h, yres - h);
+            simple_fb_set_scroll(info, 0);
+            par->scroll_wraps++;
+        }
+        return true;
+    }
+    
+    n = area->dy - area->sy;
+    if (area->sy || area->dy + h > yres || origin < n)
+        return false;
+    
+    // Rows [0, n) and [n + h, yres) keep their old contents
+    simple_fb_move_rows(info, origin - n, origin, n);
+    simple_fb_move_rows(info, origin + h, origin + n + h, yres - n - h);
+    simple_fb_set_scroll(info, origin - n);
+    par->scroll_pans++;
+    return true;
 }
 
 // Copy area (hardware acceleration stub)
 static void simple_fb_copyarea(struct fb_info *info,
                                const struct fb_copyarea *area)
 {
+    struct simple_fb_par *par = info->par;
+    struct fb_copyarea a = *area;
+    
     pr_debug("copyarea: sx=%d, sy=%d, dx=%d, dy=%d, width=%d, height=%d\n",
              area->sx, area->sy, area->dx, area->dy,
              area->width, area->height);
     
-    // Use software fallback
-    sys_copyarea(info, area);
+    if (!simple_fb_copyarea_pan(info, area)) {
+        // Use software fallback
+        a.sy += par->scroll_y;
+        a.dy += par->scroll_y;
+        sys_copyarea(info, &a);
+    }
+    simple_fb_damage(par);
+}
+
+static u32 glyph_hash(const u8 *bits, unsigned int height, u32 fg, u32 bg,
+                      unsigned int bpp)
+{
+    return jhash(bits, height, jhash_3words(fg, bg, bpp | height << 8, 0));
+}
+
+static void glyph_expand(struct glyph_entry *g)
+{
+    unsigned int Bpp = g->bpp / 8;
+    u8 *dst = g->pixels;
+    unsigned int r, x;
+    
+    for (r = 0; r < g->height; r++) {
+        for (x = 0; x < GLYPH_CELL_W; x++, dst += Bpp) {
+            u32 px = (g->bits[r] & (0x80 >> x)) ? g->fg : g->bg;
+            
+            switch (Bpp) {
+            case 4:
+                put_unaligned(px, (u32 *)dst);
+                break;
+            case 3:
+                dst[0] = px;
+                dst[1] = px >> 8;
+                dst[2] = px >> 16;
+                break;
+            case 2:
+                put_unaligned((u16)px, (u16 *)dst);
+                break;
+            }
+        }
+    }
+}
+
+// Caller holds cache->lock
+static struct glyph_entry *glyph_lookup(struct glyph_cache *cache, const u8 *bits,
+                                        unsigned int height, u32 fg, u32 bg,
+                                        unsigned int bpp)
+{
+    u32 key = glyph_hash(bits, height, fg, bg, bpp);
+    struct glyph_entry *g;
+    
+    hash_for_each_possible(cache->table, g, hnode, key) {
+        if (g->fg == fg && g->bg == bg && g->bpp == bpp &&
+            g->height == height && !memcmp(g->bits, bits, height)) {
+            list_move(&g->lru, &cache->lru);
+            cache->hits++;
+            return g;
+        }
+    }
+    
+    // Miss: take a free slot, or recycle the least recently used entry
+    if (cache->nr_used < cache->size) {
+        g = &cache->pool[cache->nr_used++];
+    } else {
+        g = list_last_entry(&cache->lru, struct glyph_entry, lru);
+        hash_del(&g->hnode);
+        list_del(&g->lru);
+    }
+    
+    g->fg = fg;
+    g->bg = bg;
+    g->bpp = bpp;
+    g->height = height;
+    memcpy(g->bits, bits, height);
+    glyph_expand(g);
+    
+    hash_add(cache->table, &g->hnode, key);
+    list_add(&g->lru, &cache->lru);
+    cache->misses++;
+    return g;
+}
+
+/*
+ * Draw a monochrome image from the glyph cache. Returns false for
+ * anything the cache does not cover, which then goes to sys_imageblit.
+ */
+static bool simple_fb_imageblit_cached(struct fb_info *info,
+                                       const struct fb_image *image)
+{
+    struct simple_fb_par *par = info->par;
+    struct glyph_cache *cache = &par->glyphs;
+    unsigned int bpp = info->var.bits_per_pixel;
+    unsigned int Bpp = bpp / 8;
+    unsigned int line = info->fix.line_length;
+    unsigned int pitch = image->width / GLYPH_CELL_W;
+    unsigned int cell, r;
+    unsigned long flags;
+    u32 fg, bg;
+    u8 *dst;
+    
+    if (!cache->size || image->depth != 1 || !image->width ||
+        image->width % GLYPH_CELL_W || !image->height ||
+        image->height > GLYPH_MAX_H)
+        return false;
+    if (info->fix.visual != FB_VISUAL_TRUECOLOR || (bpp != 16 && bpp != 24 && bpp != 32))
+        return false;
+    if (image->fg_color >= 16 || image->bg_color >= 16)
+        return false;
+    if (image->dx + image->width > info->var.xres_virtual ||
+        image->dy + image->height > info->var.yres_virtual ||
+        (size_t)(image->dy + image->height - 1) * line +
+        (image->dx + image->width) * Bpp > par->fb_size)
+        return false;
+    
+    fg = par->pseudo_palette[image->fg_color];
+    bg = par->pseudo_palette[image->bg_color];
+    dst = (u8 *)par->fb_virt + image->dy * line + image->dx * Bpp;
+    
+    /*
+     * The panic console can arrive here with the lock held by the code it
+     * interrupted. Never spin then; the uncached path needs no lock.
+     */
+    if (unlikely(oops_in_progress)) {
+        if (!spin_trylock_irqsave(&cache->lock, flags))
+            return false;
+    } else {
+        spin_lock_irqsave(&cache->lock, flags);
+    }
+    for (cell = 0; cell < pitch; cell++) {
+        u8 bits[GLYPH_MAX_H];
+        struct glyph_entry *g;
+        
+        for (r = 0; r < image->height; r++)
+            bits[r] = image->data[r * pitch + cell];
+        
+        g = glyph_lookup(cache, bits, image->height, fg, bg, bpp);
+        for (r = 0; r < image->height; r++)
+            memcpy(dst + r * line + cell * GLYPH_CELL_W * Bpp,
+                   g->pixels + r * GLYPH_CELL_W * Bpp, GLYPH_CELL_W * Bpp);
+    }
+    spin_unlock_irqrestore(&cache->lock, flags);
+    
+    return true;
 }
 
 // Image blit (hardware acceleration stub)
 static void simple_fb_imageblit(struct fb_info *info,
                                 const struct fb_image *image)
 {
+    struct simple_fb_par *par = info->par;
+    struct fb_image img = *image;
+    
     pr_debug("imageblit: x=%d, y=%d, width=%d, height=%d\n",
              image->dx, image->dy, image->width, image->height);
     
-    // Use software fallback
-    sys_imageblit(info, image);
+    img.dy += par->scroll_y;
+    // Use software fallback on a cache miss
+    if (!simple_fb_imageblit_cached(info, &img))
+        sys_imageblit(info, &img);
+    simple_fb_damage(par);
+}
+
+/*
+ * Huge page mode mapping. Nothing is mapped up front: faults insert one
+ * PMD per 2 MiB chunk where the user address and file offset are both
+ * PMD aligned, and fall back to single PTEs everywhere else.
+ */
+static unsigned long simple_fb_huge_pfn(struct simple_fb_par *par, pgoff_t pgoff)
+{
+    unsigned long offset = pgoff << PAGE_SHIFT;
+    
+    return page_to_pfn(par->huge_pages[offset >> PMD_SHIFT]) +
+           ((offset & ~PMD_MASK) >> PAGE_SHIFT);
+}
+
+static vm_fault_t simple_fb_vm_fault(struct vm_fault *vmf)
+{
+    struct simple_fb_par *par = vmf->vma->vm_private_data;
+    
+    if (vmf->pgoff >= par->fb_size >> PAGE_SHIFT)
+        return VM_FAULT_SIGBUS;
+    
+    return vmf_insert_pfn(vmf->vma, vmf->address,
+                          simple_fb_huge_pfn(par, vmf->pgoff));
 }
 
+#ifdef CONFIG_TRANSPARENT_HUGEPAGE
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(6, 6, 0)
+static vm_fault_t simple_fb_vm_huge_fault(struct vm_fault *vmf, unsigned int order)
+#else
+static vm_fault_t simple_fb_vm_huge_fault(struct vm_fault *vmf,
+                                          enum page_entry_size pe_size)
+#endif
+{
+    struct vm_area_struct *vma = vmf->vma;
+    struct simple_fb_par *par = vma->vm_private_data;
+    unsigned long addr = vmf->address & PMD_MASK;
+    pgoff_t pgoff;
+    
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(6, 6, 0)
+    if (order != FB_HUGE_ORDER)
+#else
+    if (pe_size != PE_SIZE_PMD)
+#endif
+        return VM_FAULT_FALLBACK;
+    
+    if (addr < vma->vm_start || addr + PMD_SIZE > vma->vm_end)
+        return VM_FAULT_FALLBACK;
+    
+    pgoff = vma->vm_pgoff + ((addr - vma->vm_start) >> PAGE_SHIFT);
+    if (pgoff & ((1UL << FB_HUGE_ORDER) - 1))
+        return VM_FAULT_FALLBACK;
+    if ((pgoff << PAGE_SHIFT) + PMD_SIZE > par->fb_size)
+        return VM_FAULT_FALLBACK;
+    
+    return vmf_insert_pfn_pmd(vmf, pfn_to_pfn_t(simple_fb_huge_pfn(par, pgoff)),
+                              vmf->flags & FAULT_FLAG_WRITE);
+}
+#endif
+
+static const struct vm_operations_struct simple_fb_huge_vm_ops = {
+    .fault      = simple_fb_vm_fault,
+#ifdef CONFIG_TRANSPARENT_HUGEPAGE
+    .huge_fault = simple_fb_vm_huge_fault,
+#endif
+};
+
 static int simple_fb_mmap(struct fb_info *info, struct vm_area_struct *vma)
 {
     struct simple_fb_par *par = info->par;
@@ -217,7 +724,32 @@ static int simple_fb_mmap(struct fb_info *info, struct vm_area_struct *vma)
     if (offset + size > par->fb_size)
         return -EINVAL;
     
-    pr_info("mmap: offset=0x%lx, size=0x%lx\n", offset, size);
+    pr_info("mmap: offset=0x%lx, size=0x%lx%s\n", offset, size,
+            par->huge_pages ? " (huge)" : "");
+    
+    if (par->huge_pages) {
+        /*
+         * PFN mappings cannot be copy-on-write: vmf_insert_pfn{,_pmd}()
+         * BUG on a private writable vma. Only shared mappings are allowed;
+         * a read-only shared mapping has VM_MAYSHARE without VM_SHARED.
+         */
+        if (!(vma->vm_flags & VM_MAYSHARE))
+            return -EINVAL;
+        
+        /*
+         * Plain RAM with no scanout engine behind it, so keep the default
+         * cached attributes: renderers read the frame as much as they
+         * write it, and write-combined reads are uncached.
+         */
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(6, 3, 0)
+        vm_flags_set(vma, VM_PFNMAP | VM_DONTEXPAND | VM_DONTDUMP | VM_HUGEPAGE);
+#else
+        vma->vm_flags |= VM_PFNMAP | VM_DONTEXPAND | VM_DONTDUMP | VM_HUGEPAGE;
+#endif
+        vma->vm_ops = &simple_fb_huge_vm_ops;
+        vma->vm_private_data = par;
+        return 0;
+    }
     
     // Map DMA coherent memory
     vma->vm_page_prot = pgprot_writecombine(vma->vm_page_prot);
@@ -245,6 +777,7 @@ static int simple_fb_ioctl(struct fb_info *info, unsigned int cmd,
         
     case 0x4601: // Custom: Clear screen
         memset(par->fb_virt, 0, par->fb_size);
+        simple_fb_damage(par);
         pr_info("Screen cleared\n");
         return 0;
         
@@ -268,6 +801,579 @@ static struct fb_ops simple_fb_ops = {
     .fb_ioctl       = simple_fb_ioctl,
 };
 
+/*
+ * Compressed frame stream
+ */
+
+struct fbstream_client {
+    struct fbstream_dev *sd;
+    struct mutex lock;
+    u8 *shadow;            // Last exported frame, as the reader rebuilt it
+    u8 *out;               // Encoded frame being read out
+    size_t out_len;
+    size_t out_pos;
+    u32 seq;
+    u32 since_key;
+    bool need_key;
+    unsigned long damage;  // sd->damage as of the last encode
+    unsigned long checked; // jiffies at the last encode
+    struct delayed_work recheck;  // Wakes poll() to look for mmap() drawing
+    // Geometry the shadow was taken with
+    u32 xres, yres, bpp, line_length, frame_len;
+};
+
+struct fbstream_enc {
+    u8 *out;
+    size_t len;
+    size_t hdr_pos;
+    u32 op;
+    u32 count;
+    u32 fill;
+    u32 bpp;
+};
+
+/*
+ * A tile is compared as eight u64 words folded into one OR of XORs. That
+ * is branch free and the compiler vectorises it where it can; explicit
+ * kernel SIMD would need kernel_fpu_begin() around every frame.
+ */
+static inline bool fbstream_tile_equal(const u64 *a, const u64 *b)
+{
+    return !((a[0] ^ b[0]) | (a[1] ^ b[1]) | (a[2] ^ b[2]) | (a[3] ^ b[3]) |
+             (a[4] ^ b[4]) | (a[5] ^ b[5]) | (a[6] ^ b[6]) | (a[7] ^ b[7]));
+}
+
+// True if the tile is one 4-byte pixel repeated; *fill gets its raw bytes
+static inline bool fbstream_tile_fill(const u64 *t, u32 *fill)
+{
+    u64 v = t[0];
+    
+    if ((u32)v != (u32)(v >> 32))
+        return false;
+    if ((t[1] ^ v) | (t[2] ^ v) | (t[3] ^ v) | (t[4] ^ v) |
+        (t[5] ^ v) | (t[6] ^ v) | (t[7] ^ v))
+        return false;
+    memcpy(fill, t, sizeof(*fill));
+    return true;
+}
+
+/*
+ * The framebuffer holds pixels in CPU order and the stream carries them
+ * little-endian, so only big-endian hosts swap. 24 bpp is bytes already.
+ */
+static void fbstream_put_pixels(u8 *dst, const u8 *src, size_t len, u32 bpp)
+{
+    size_t i;
+    
+    if (!IS_ENABLED(CONFIG_CPU_BIG_ENDIAN) || (bpp != 16 && bpp != 32)) {
+        memcpy(dst, src, len);
+        return;
+    }
+    if (bpp == 16)
+        for (i = 0; i < len; i += 2)
+            put_unaligned_le16(get_unaligned((const u16 *)(src + i)), dst + i);
+    else
+        for (i = 0; i < len; i += 4)
+            put_unaligned_le32(get_unaligned((const u32 *)(src + i)), dst + i);
+}
+
+static void fbstream_flush(struct fbstream_enc *e)
+{
+    if (!e->count)
+        return;
+    put_unaligned_le32((e->op << FBSTREAM_OP_SHIFT) | e->count,
+                       e->out + e->hdr_pos);
+    e->count = 0;
+}
+
+// Add one tile, extending the current op when it is the same kind of run
+static void fbstream_emit(struct fbstream_enc *e, u32 op, u32 fill,
+                          const void *tile)
+{
+    if (e->count && (op != e->op || e->count == FBSTREAM_MAX_COUNT ||
+                     (op == FBSTREAM_OP_FILL && fill != e->fill)))
+        fbstream_flush(e);
+    
+    if (!e->count) {
+        e->op = op;
+        e->fill = fill;
+        e->hdr_pos = e->len;
+        e->len += 4;
+        if (op == FBSTREAM_OP_FILL) {
+            fbstream_put_pixels(e->out + e->len, (u8 *)&fill, 4, e->bpp);
+            e->len += 4;
+        }
+    }
+    
+    if (op == FBSTREAM_OP_RAW) {
+        fbstream_put_pixels(e->out + e->len, tile, FBSTREAM_TILE, e->bpp);
+        e->len += FBSTREAM_TILE;
+    }
+    e->count++;
+}
+
+// Size the shadow and output buffers for the current mode
+static int fbstream_set_geometry(struct fbstream_client *c,
+                                 struct fb_info *info, u32 frame_len)
+{
+    size_t out_size = sizeof(struct fbstream_hdr) +
+                      (frame_len / FBSTREAM_TILE) * FBSTREAM_MAX_TILE_BYTES;
+    
+    vfree(c->shadow);
+    vfree(c->out);
+    c->shadow = vzalloc(frame_len);
+    c->out = vmalloc(out_size);
+    if (!c->shadow || !c->out) {
+        vfree(c->shadow);
+        vfree(c->out);
+        c->shadow = NULL;
+        c->out = NULL;
+        c->frame_len = 0;
+        return -ENOMEM;
+    }
+    
+    c->xres = info->var.xres;
+    c->yres = info->var.yres;
+    c->bpp = info->var.bits_per_pixel;
+    c->line_length = info->fix.line_length;
+    c->frame_len = frame_len;
+    c->need_key = true;
+    return 0;
+}
+
+// Returns -EAGAIN, and emits nothing, when no tile changed
+static int fbstream_encode(struct fbstream_client *c, struct fb_info *info)
+{
+    struct simple_fb_par *par = info->par;
+    u32 line = info->fix.line_length;
+    u32 frame_len = round_up(line * info->var.yres, FBSTREAM_TILE);
+    size_t start = (size_t)info->var.yoffset * line;
+    const u8 *src = par->fb_virt;
+    struct fbstream_hdr *hdr;
+    struct fbstream_enc e;
+    u64 tile[FBSTREAM_TILE / 8];
+    size_t off;
+    bool key, changed = false;
+    u32 fill;
+    int ret;
+    
+    if (start + frame_len > par->fb_size)
+        return -EINVAL;
+    
+    if (frame_len != c->frame_len || line != c->line_length ||
+        info->var.xres != c->xres || info->var.yres != c->yres ||
+        info->var.bits_per_pixel != c->bpp) {
+        ret = fbstream_set_geometry(c, info, frame_len);
+        if (ret)
+            return ret;
+    }
+    
+    key = c->need_key || (keyframe_interval && c->since_key >= keyframe_interval);
+    
+    e.out = c->out;
+    e.len = sizeof(*hdr);
+    e.count = 0;
+    e.bpp = c->bpp;
+    
+    /*
+     * Each tile is copied out once and everything else works on that
+     * copy, so the shadow always matches what was encoded even while
+     * the frame is being drawn into.
+     */
+    for (off = 0; off < frame_len; off += FBSTREAM_TILE) {
+        memcpy(tile, src + start + off, FBSTREAM_TILE);
+        
+        if (!key && fbstream_tile_equal(tile, (u64 *)(c->shadow + off))) {
+            fbstream_emit(&e, FBSTREAM_OP_SKIP, 0, NULL);
+            continue;
+        }
+        
+        memcpy(c->shadow + off, tile, FBSTREAM_TILE);
+        changed = true;
+        if (fbstream_tile_fill(tile, &fill))
+            fbstream_emit(&e, FBSTREAM_OP_FILL, fill, NULL);
+        else
+            fbstream_emit(&e, FBSTREAM_OP_RAW, 0, tile);
+    }
+    fbstream_flush(&e);
+    if (!changed)
+        return -EAGAIN;
+    
+    hdr = (struct fbstream_hdr *)c->out;
+    hdr->magic = cpu_to_le32(FBSTREAM_MAGIC);
+    hdr->type = cpu_to_le16(key ? FBSTREAM_KEYFRAME : FBSTREAM_DELTA);
+    hdr->tile_size = cpu_to_le16(FBSTREAM_TILE);
+    hdr->seq = cpu_to_le32(c->seq++);
+    hdr->xres = cpu_to_le32(c->xres);
+    hdr->yres = cpu_to_le32(c->yres);
+    hdr->bits_per_pixel = cpu_to_le32(c->bpp);
+    hdr->line_length = cpu_to_le32(c->line_length);
+    hdr->frame_len = cpu_to_le32(frame_len);
+    hdr->payload_len = cpu_to_le32(e.len - sizeof(*hdr));
+    
+    c->out_len = e.len;
+    c->out_pos = 0;
+    c->since_key = key ? 1 : c->since_key + 1;
+    c->need_key = false;
+    return 0;
+}
+
+/*
+ * Encode the next frame if anything changed. The damage count is taken
+ * before the frame is read, so drawing that races with the encode is
+ * picked up by the next one.
+ */
+static int fbstream_next(struct fbstream_client *c)
+{
+    struct fbstream_dev *sd = c->sd;
+    int ret = -ENODEV;
+    
+    down_read(&sd->lock);
+    c->damage = smp_load_acquire(&sd->damage);
+    c->checked = jiffies;
+    if (sd->info)
+        ret = fbstream_encode(c, sd->info);
+    up_read(&sd->lock);
+    return ret;
+}
+
+// True if the next encode may find something, or the device is gone
+static bool fbstream_ready(struct fbstream_client *c)
+{
+    struct fbstream_dev *sd = c->sd;
+    
+    return !READ_ONCE(sd->info) || READ_ONCE(c->need_key) ||
+           READ_ONCE(sd->damage) != READ_ONCE(c->damage) ||
+           time_after_eq(jiffies, READ_ONCE(c->checked) + FBSTREAM_RECHECK);
+}
+
+static void fbstream_recheck(struct work_struct *work)
+{
+    struct fbstream_client *c = container_of(to_delayed_work(work),
+                                             struct fbstream_client, recheck);
+    
+    wake_up_interruptible_poll(&c->sd->wait, EPOLLIN | EPOLLRDNORM);
+}
+
+static void fbstream_dev_free(struct kref *ref)
+{
+    kfree(container_of(ref, struct fbstream_dev, ref));
+}
+
+/*
+ * misc_open() holds the misc device lock, and remove deregisters the misc
+ * device before anything else, so par is still alive here.
+ */
+static int fbstream_open(struct inode *inode, struct file *file)
+{
+    struct simple_fb_par *par = container_of(file->private_data,
+                                             struct simple_fb_par, stream);
+    struct fbstream_client *c;
+    
+    c = kzalloc(sizeof(*c), GFP_KERNEL);
+    if (!c)
+        return -ENOMEM;
+    
+    c->sd = par->stream_dev;
+    kref_get(&c->sd->ref);
+    c->need_key = true;
+    c->checked = jiffies;
+    mutex_init(&c->lock);
+    INIT_DELAYED_WORK(&c->recheck, fbstream_recheck);
+    file->private_data = c;
+    return 0;
+}
+
+static int fbstream_release(struct inode *inode, struct file *file)
+{
+    struct fbstream_client *c = file->private_data;
+    
+    cancel_delayed_work_sync(&c->recheck);
+    kref_put(&c->sd->ref, fbstream_dev_free);
+    vfree(c->shadow);
+    vfree(c->out);
+    kfree(c);
+    return 0;
+}
+
+/*
+ * A frame is encoded when the previous one has been read out completely,
+ * so a short read() just continues the same frame on the next call. An
+ * unchanged frame is never sent: read() sleeps until drawing wakes it or
+ * the next recheck finds a change, or fails with -EAGAIN under O_NONBLOCK.
+ */
+static ssize_t fbstream_read(struct file *file, char __user *buf,
+                             size_t count, loff_t *ppos)
+{
+    struct fbstream_client *c = file->private_data;
+    ssize_t ret = 0;
+    size_t n;
+    
+    if (mutex_lock_interruptible(&c->lock))
+        return -ERESTARTSYS;
+    
+    while (c->out_pos == c->out_len) {
+        ret = fbstream_ready(c) ? fbstream_next(c) : -EAGAIN;
+        if (ret != -EAGAIN)
+            break;
+        if (file->f_flags & O_NONBLOCK)
+            goto out;
+        
+        mutex_unlock(&c->lock);
+        if (wait_event_interruptible_timeout(c->sd->wait, fbstream_ready(c),
+                                             FBSTREAM_RECHECK) < 0)
+            return -ERESTARTSYS;
+        if (mutex_lock_interruptible(&c->lock))
+            return -ERESTARTSYS;
+    }
+    if (ret)
+        goto out;
+    
+    n = min(count, c->out_len - c->out_pos);
+    if (copy_to_user(buf, c->out + c->out_pos, n)) {
+        ret = -EFAULT;
+        goto out;
+    }
+    c->out_pos += n;
+    ret = n;
+    
+out:
+    mutex_unlock(&c->lock);
+    return ret;
+}
+
+static __poll_t fbstream_poll(struct file *file, poll_table *wait)
+{
+    struct fbstream_client *c = file->private_data;
+    unsigned long due;
+    
+    poll_wait(file, &c->sd->wait, wait);
+    if (!READ_ONCE(c->sd->info))
+        return EPOLLHUP | EPOLLERR;
+    if (READ_ONCE(c->out_pos) != READ_ONCE(c->out_len) || fbstream_ready(c))
+        return EPOLLIN | EPOLLRDNORM;
+    
+    // Nothing wakes us for mmap() drawing, so come back at the next recheck
+    due = READ_ONCE(c->checked) + FBSTREAM_RECHECK;
+    schedule_delayed_work(&c->recheck,
+                          time_after(due, jiffies) ? due - jiffies : 0);
+    return 0;
+}
+
+static long fbstream_ioctl(struct file *file, unsigned int cmd,
+                           unsigned long arg)
+{
+    struct fbstream_client *c = file->private_data;
+    
+    switch (cmd) {
+    case FBSTREAM_IOC_KEYFRAME:
+        mutex_lock(&c->lock);
+        c->need_key = true;
+        mutex_unlock(&c->lock);
+        wake_up_interruptible_poll(&c->sd->wait, EPOLLIN | EPOLLRDNORM);
+        return 0;
+    default:
+        return -ENOTTY;
+    }
+}
+
+static const struct file_operations fbstream_fops = {
+    .owner          = THIS_MODULE,
+    .open           = fbstream_open,
+    .release        = fbstream_release,
+    .read           = fbstream_read,
+    .poll           = fbstream_poll,
+    .unlocked_ioctl = fbstream_ioctl,
+    .llseek         = noop_llseek,
+};
+
+static struct fbstream_dev *fbstream_dev_alloc(struct fb_info *info)
+{
+    struct fbstream_dev *sd = kzalloc(sizeof(*sd), GFP_KERNEL);
+    
+    if (!sd)
+        return NULL;
+    kref_init(&sd->ref);
+    init_rwsem(&sd->lock);
+    init_waitqueue_head(&sd->wait);
+    sd->info = info;
+    return sd;
+}
+
+// Cut open fds off from the device; they see -ENODEV from now on
+static void fbstream_dev_detach(struct fbstream_dev *sd)
+{
+    down_write(&sd->lock);
+    sd->info = NULL;
+    up_write(&sd->lock);
+    wake_up_interruptible_poll(&sd->wait, EPOLLHUP | EPOLLERR);
+    kref_put(&sd->ref, fbstream_dev_free);
+}
+
+/*
+ * Glyph cache setup, sysfs statistics
+ */
+
+static int simple_fb_glyph_cache_init(struct glyph_cache *cache)
+{
+    spin_lock_init(&cache->lock);
+    hash_init(cache->table);
+    INIT_LIST_HEAD(&cache->lru);
+    cache->size = glyph_cache_size;
+    if (!cache->size)
+        return 0;
+    
+    cache->pool = kvcalloc(cache->size, sizeof(*cache->pool), GFP_KERNEL);
+    if (!cache->pool) {
+        cache->size = 0;
+        return -ENOMEM;
+    }
+    return 0;
+}
+
+static void simple_fb_glyph_cache_free(struct glyph_cache *cache)
+{
+    kvfree(cache->pool);
+    cache->pool = NULL;
+    cache->size = 0;
+}
+
+static ssize_t glyph_cache_show(struct device *dev,
+                                struct device_attribute *attr, char *buf)
+{
+    struct fb_info *info = dev_get_drvdata(dev);
+    struct simple_fb_par *par = info->par;
+    struct glyph_cache *cache = &par->glyphs;
+    unsigned long flags, hits, misses;
+    unsigned int used;
+    
+    spin_lock_irqsave(&cache->lock, flags);
+    hits = cache->hits;
+    misses = cache->misses;
+    used = cache->nr_used;
+    spin_unlock_irqrestore(&cache->lock, flags);
+    
+    return sysfs_emit(buf, "hits %lu\nmisses %lu\nentries %u\nsize %u\n",
+                      hits, misses, used, cache->size);
+}
+static DEVICE_ATTR_RO(glyph_cache);
+
+static ssize_t scroll_show(struct device *dev, struct device_attribute *attr,
+                           char *buf)
+{
+    struct fb_info *info = dev_get_drvdata(dev);
+    struct simple_fb_par *par = info->par;
+    
+    return sysfs_emit(buf, "origin %u\npans %lu\nwraps %lu\n",
+                      par->scroll_y, par->scroll_pans, par->scroll_wraps);
+}
+static DEVICE_ATTR_RO(scroll);
+
+static struct attribute *simple_fb_attrs[] = {
+    &dev_attr_glyph_cache.attr,
+    &dev_attr_scroll.attr,
+    NULL,
+};
+
+static const struct attribute_group simple_fb_attr_group = {
+    .attrs = simple_fb_attrs,
+};
+
+/*
+ * Framebuffer memory
+ */
+
+static void simple_fb_free_huge(struct simple_fb_par *par)
+{
+    unsigned int i;
+    
+    if (par->fb_virt)
+        vunmap(par->fb_virt);
+    for (i = 0; i < par->nr_huge; i++)
+        __free_pages(par->huge_pages[i], FB_HUGE_ORDER);
+    kfree(par->huge_pages);
+    par->huge_pages = NULL;
+    par->nr_huge = 0;
+    par->fb_virt = NULL;
+}
+
+/*
+ * The chunks need not be contiguous with each other. The kernel sees them
+ * through one vmap() of their base pages, userspace through PMD mappings.
+ */
+static int simple_fb_alloc_huge(struct simple_fb_par *par, size_t size)
+{
+    unsigned int nr = DIV_ROUND_UP(size, PMD_SIZE);
+    unsigned int per_chunk = 1U << FB_HUGE_ORDER;
+    struct page **pages;
+    unsigned int i, j;
+    
+    par->huge_pages = kcalloc(nr, sizeof(*par->huge_pages), GFP_KERNEL);
+    if (!par->huge_pages)
+        return -ENOMEM;
+    
+    for (i = 0; i < nr; i++) {
+        par->huge_pages[i] = alloc_pages(GFP_KERNEL | __GFP_ZERO | __GFP_NOWARN |
+                                         __GFP_NORETRY, FB_HUGE_ORDER);
+        if (!par->huge_pages[i])
+            goto err;
+        par->nr_huge++;
+    }
+    
+    pages = kvmalloc_array(nr * per_chunk, sizeof(*pages), GFP_KERNEL);
+    if (!pages)
+        goto err;
+    for (i = 0; i < nr; i++)
+        for (j = 0; j < per_chunk; j++)
+            pages[i * per_chunk + j] = par->huge_pages[i] + j;
+    par->fb_virt = vmap(pages, nr * per_chunk, VM_MAP, PAGE_KERNEL);
+    kvfree(pages);
+    if (!par->fb_virt)
+        goto err;
+    
+    par->fb_size = (size_t)nr * PMD_SIZE;
+    // Only the first chunk's address is meaningful to FBIOGET_FSCREENINFO
+    par->fb_phys = page_to_phys(par->huge_pages[0]);
+    return 0;
+    
+err:
+    simple_fb_free_huge(par);
+    return -ENOMEM;
+}
+
+static int simple_fb_alloc_mem(struct simple_fb_par *par)
+{
+    struct device *dev = &par->pdev->dev;
+    size_t size = PAGE_ALIGN(FB_WIDTH * FB_HEIGHT * (FB_BPP / 8) * virt_screens);
+    
+    if (hugepage) {
+        if (!simple_fb_alloc_huge(par, size))
+            return 0;
+        dev_warn(dev, "Huge page allocation failed, using base pages\n");
+    }
+    
+    par->fb_size = size;
+    
+    // Allocate DMA coherent memory for framebuffer
+    par->fb_virt = dma_alloc_coherent(dev, par->fb_size,
+                                      &par->fb_phys, GFP_KERNEL);
+    if (!par->fb_virt)
+        return -ENOMEM;
+    
+    // Clear framebuffer
+    memset(par->fb_virt, 0, par->fb_size);
+    return 0;
+}
+
+static void simple_fb_free_mem(struct simple_fb_par *par)
+{
+    if (par->huge_pages)
+        simple_fb_free_huge(par);
+    else
+        dma_free_coherent(&par->pdev->dev, par->fb_size,
+                          par->fb_virt, par->fb_phys);
+}
+
 /*
  * Platform driver probe/remove
  */
@@ -280,6 +1386,11 @@ static int simple_fb_probe(struct platform_device *pdev)
     
     pr_info("%s: Probing framebuffer driver\n", DRIVER_NAME);
     
+    if (!virt_screens || virt_screens > FB_MAX_VIRT_SCREENS) {
+        dev_warn(&pdev->dev, "virt_screens=%u out of range, using 1\n", virt_screens);
+        virt_screens = 1;
+    }
+    
     // Allocate framebuffer info structure
     info = framebuffer_alloc(sizeof(struct simple_fb_par), &pdev->dev);
     if (!info) {
@@ -291,41 +1402,52 @@ static int simple_fb_probe(struct platform_device *pdev)
     par->pdev = pdev;
     platform_set_drvdata(pdev, info);
     
-    // Calculate framebuffer size
-    par->fb_size = FB_WIDTH * FB_HEIGHT * (FB_BPP / 8);
-    par->fb_size = PAGE_ALIGN(par->fb_size);
-    
-    // Allocate DMA coherent memory for framebuffer
-    par->fb_virt = dma_alloc_coherent(&pdev->dev, par->fb_size,
-                                      &par->fb_phys, GFP_KERNEL);
-    if (!par->fb_virt) {
+    ret = simple_fb_alloc_mem(par);
+    if (ret) {
         dev_err(&pdev->dev, "Failed to allocate framebuffer memory\n");
-        ret = -ENOMEM;
         goto err_fb_release;
     }
     
-    // Clear framebuffer
-    memset(par->fb_virt, 0, par->fb_size);
-    
-    dev_info(&pdev->dev, "Framebuffer: virt=%p, phys=0x%pad, size=0x%zx\n",
-             par->fb_virt, &par->fb_phys, par->fb_size);
+    dev_info(&pdev->dev, "Framebuffer: virt=%p, phys=0x%pad, size=0x%zx%s\n",
+             par->fb_virt, &par->fb_phys, par->fb_size,
+             par->huge_pages ? " (huge pages)" : "");
     
     // Setup fb_info
     info->fbops = &simple_fb_ops;
-    info->flags = FBINFO_DEFAULT | FBINFO_HWACCEL_DISABLED;
+    /*
+     * With a virtual area to pan in, copyarea is the fast path. fbcon only
+     * acts on this flag when it still scrolls with copyarea at all, see
+     * FBCON_SCROLLS_WITH_COPYAREA.
+     */
+    if (virt_screens > 1)
+        info->flags = FBINFO_DEFAULT | FBINFO_HWACCEL_COPYAREA;
+    else
+        info->flags = FBINFO_DEFAULT | FBINFO_HWACCEL_DISABLED;
     info->pseudo_palette = par->pseudo_palette;
     info->var = simple_fb_var;
+    info->var.yres_virtual = FB_HEIGHT * virt_screens;
     info->fix = simple_fb_fix;
     info->fix.smem_start = par->fb_phys;
     info->fix.smem_len = par->fb_size;
     info->screen_base = par->fb_virt;
     info->screen_size = par->fb_size;
     
+    // A missing cache only costs speed, so carry on without it
+    if (simple_fb_glyph_cache_init(&par->glyphs))
+        dev_warn(&pdev->dev, "No memory for glyph cache, disabled\n");
+    
+    // Drawing reports damage to it from the moment fbcon takes over
+    par->stream_dev = fbstream_dev_alloc(info);
+    if (!par->stream_dev) {
+        ret = -ENOMEM;
+        goto err_dma_free;
+    }
+    
     // Allocate color map
     ret = fb_alloc_cmap(&info->cmap, 256, 0);
     if (ret) {
         dev_err(&pdev->dev, "Failed to allocate color map\n");
-        goto err_dma_free;
+        goto err_stream_free;
     }
     
     // Register framebuffer
@@ -335,6 +1457,20 @@ static int simple_fb_probe(struct platform_device *pdev)
         goto err_dealloc_cmap;
     }
     
+    // Compressed export interface
+    par->stream.minor = MISC_DYNAMIC_MINOR;
+    par->stream.name = "simple_fb_stream";
+    par->stream.fops = &fbstream_fops;
+    par->stream.parent = &pdev->dev;
+    ret = misc_register(&par->stream);
+    if (ret) {
+        dev_err(&pdev->dev, "Failed to register stream device\n");
+        goto err_unregister_fb;
+    }
+    
+    if (sysfs_create_group(&pdev->dev.kobj, &simple_fb_attr_group))
+        dev_warn(&pdev->dev, "Failed to create sysfs attributes\n");
+    
     dev_info(&pdev->dev, "Framebuffer registered: fb%d (%s)\n",
              info->node, info->fix.id);
     dev_info(&pdev->dev, "Mode: %dx%d-%d\n",
@@ -342,10 +1478,15 @@ static int simple_fb_probe(struct platform_device *pdev)
     
     return 0;
     
+err_unregister_fb:
+    unregister_framebuffer(info);
 err_dealloc_cmap:
     fb_dealloc_cmap(&info->cmap);
+err_stream_free:
+    fbstream_dev_detach(par->stream_dev);
 err_dma_free:
-    dma_free_coherent(&pdev->dev, par->fb_size, par->fb_virt, par->fb_phys);
+    simple_fb_glyph_cache_free(&par->glyphs);
+    simple_fb_free_mem(par);
 err_fb_release:
     framebuffer_release(info);
     return ret;
@@ -358,9 +1499,14 @@ static int simple_fb_remove(struct platform_device *pdev)
     
     pr_info("%s: Removing framebuffer driver\n", DRIVER_NAME);
     
+    sysfs_remove_group(&pdev->dev.kobj, &simple_fb_attr_group);
+    misc_deregister(&par->stream);
     unregister_framebuffer(info);
+    // No more drawing; fds still open on the stream outlive par
+    fbstream_dev_detach(par->stream_dev);
     fb_dealloc_cmap(&info->cmap);
-    dma_free_coherent(&pdev->dev, par->fb_size, par->fb_virt, par->fb_phys);
+    simple_fb_glyph_cache_free(&par->glyphs);
+    simple_fb_free_mem(par);
     framebuffer_release(info);
     
     return 0;
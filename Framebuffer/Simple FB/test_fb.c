@@ -7,7 +7,13 @@
 #include <sys/ioctl.h>
 #include <linux/fb.h>
 #include <string.h>
+#include <errno.h>
 #include <stdint.h>
+#include <endian.h>
+#include <poll.h>
+#include <time.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
 
 #define FB_DEVICE "/dev/fb0"
 
@@ -233,6 +239,389 @@ void test_animation(struct framebuffer *fb) {
     }
 }
 
+/*
+ * Memory walk benchmark for the huge page mode. The same buffer is mapped
+ * twice: once at a 2 MiB aligned address, where simple_fb can use PMD
+ * entries, and once 4 KiB off that, which forces base pages. Each mapping
+ * is walked column by column (a new page every row or so, the worst case
+ * for the TLB) and row by row, and dTLB misses are counted with perf.
+ */
+#define HUGE_ALIGN (2UL << 20)
+#define BENCH_PASSES 20
+
+static int perf_open_dtlb(void) {
+    struct perf_event_attr attr;
+    
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = PERF_TYPE_HW_CACHE;
+    attr.config = PERF_COUNT_HW_CACHE_DTLB |
+                  (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                  (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+    attr.disabled = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    return syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+}
+
+static uint32_t *map_at(int fd, size_t size, unsigned long misalign) {
+    uint8_t *area, *addr;
+    void *map;
+    
+    // Reserve enough to pick an aligned address, then map over it
+    area = mmap(NULL, size + 2 * HUGE_ALIGN, PROT_NONE,
+                MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (area == MAP_FAILED)
+        return NULL;
+    addr = (uint8_t *)(((uintptr_t)area + HUGE_ALIGN - 1) & ~(HUGE_ALIGN - 1)) +
+           misalign;
+    map = mmap(addr, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED,
+               fd, 0);
+    return map == MAP_FAILED ? NULL : map;
+}
+
+static double now_sec(void) {
+    struct timespec ts;
+    
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void bench_walk(const char *label, uint32_t *buf, size_t size,
+                       int width, int height, int stride, int perf_fd) {
+    volatile uint32_t sink = 0;
+    long long misses[2] = { -1, -1 };
+    double secs[2];
+    int pass, x, y, mode;
+    uint32_t sum;
+    double t0;
+    
+    // Fault everything in before timing
+    for (y = 0; y < size / 4; y += 1024)
+        sink += buf[y];
+    
+    for (mode = 0; mode < 2; mode++) {
+        if (perf_fd >= 0) {
+            ioctl(perf_fd, PERF_EVENT_IOC_RESET, 0);
+            ioctl(perf_fd, PERF_EVENT_IOC_ENABLE, 0);
+        }
+        t0 = now_sec();
+        for (pass = 0; pass < BENCH_PASSES; pass++) {
+            sum = 0;
+            if (mode == 0) {
+                for (x = 0; x < width; x++)
+                    for (y = 0; y < height; y++)
+                        sum += buf[y * stride + x]++;
+            } else {
+                for (y = 0; y < height; y++)
+                    for (x = 0; x < width; x++)
+                        sum += buf[y * stride + x]++;
+            }
+            sink += sum;
+        }
+        secs[mode] = now_sec() - t0;
+        if (perf_fd >= 0) {
+            ioctl(perf_fd, PERF_EVENT_IOC_DISABLE, 0);
+            if (read(perf_fd, &misses[mode], sizeof(misses[mode])) != sizeof(misses[mode]))
+                misses[mode] = -1;
+        }
+    }
+    
+    for (mode = 0; mode < 2; mode++) {
+        double bytes = (double)width * height * 4 * 2 * BENCH_PASSES;
+        
+        printf("  %-10s %-7s %8.2f GB/s", label, mode ? "rows" : "columns",
+               bytes / secs[mode] / 1e9);
+        if (misses[mode] >= 0)
+            printf("  %12lld dTLB misses\n", misses[mode]);
+        else
+            printf("  dTLB misses n/a\n");
+    }
+    (void)sink;
+}
+
+static int simple_fb_hugepage(void) {
+    FILE *f = fopen("/sys/module/simple_fb/parameters/hugepage", "r");
+    int c = EOF;
+    
+    if (f) {
+        c = fgetc(f);
+        fclose(f);
+    }
+    return c == 'Y';
+}
+
+// Huge mode maps PFNs, which cannot be copy-on-write: MAP_PRIVATE must fail
+static void check_private_map(struct framebuffer *fb) {
+    void *map = mmap(NULL, 4096, PROT_READ | PROT_WRITE, MAP_PRIVATE, fb->fd, 0);
+    
+    if (map != MAP_FAILED) {
+        printf("  MAP_PRIVATE mapping: accepted (FAILED, expected EINVAL)\n");
+        munmap(map, 4096);
+    } else if (errno != EINVAL) {
+        printf("  MAP_PRIVATE mapping: %s (FAILED, expected EINVAL)\n",
+               strerror(errno));
+    } else {
+        printf("  MAP_PRIVATE mapping: rejected with EINVAL (ok)\n");
+    }
+}
+
+void test_tlb_bench(struct framebuffer *fb) {
+    size_t size = fb->finfo.smem_len;
+    int stride = fb->finfo.line_length / 4;
+    int perf_fd = perf_open_dtlb();
+    uint32_t *huge, *base;
+    
+    printf("Memory walk benchmark (%d passes, read+write)...\n", BENCH_PASSES);
+    if (perf_fd < 0)
+        perror("perf_event_open (dTLB counts disabled)");
+    
+    if (simple_fb_hugepage())
+        check_private_map(fb);
+    
+    huge = map_at(fb->fd, size, 0);
+    base = map_at(fb->fd, size, 4096);
+    if (!huge || !base) {
+        perror("Error mapping framebuffer for benchmark");
+        return;
+    }
+    
+    bench_walk("aligned", huge, size, fb->vinfo.xres, fb->vinfo.yres,
+               stride, perf_fd);
+    bench_walk("unaligned", base, size, fb->vinfo.xres, fb->vinfo.yres,
+               stride, perf_fd);
+    printf("With simple_fb hugepage=1 the aligned mapping uses PMD entries;\n"
+           "otherwise both rows should match.\n");
+    
+    munmap(huge, size);
+    munmap(base, size);
+    if (perf_fd >= 0)
+        close(perf_fd);
+}
+
+/*
+ * Compressed stream client: reads frames from the stream device, rebuilds
+ * them locally and checks the result against the mapped framebuffer.
+ */
+#define FBSTREAM_DEVICE "/dev/simple_fb_stream"
+#define FBSTREAM_MAGIC 0x53424653
+#define FBSTREAM_KEYFRAME 1
+#define FBSTREAM_OP_SKIP 0
+#define FBSTREAM_OP_FILL 1
+#define FBSTREAM_OP_RAW 2
+#define FBSTREAM_OP_SHIFT 30
+
+// Everything on the wire is little-endian
+struct fbstream_hdr {
+    uint32_t magic;
+    uint16_t type;
+    uint16_t tile_size;
+    uint32_t seq;
+    uint32_t xres;
+    uint32_t yres;
+    uint32_t bits_per_pixel;
+    uint32_t line_length;
+    uint32_t frame_len;
+    uint32_t payload_len;
+};
+
+static int read_full(int fd, void *buf, size_t len) {
+    uint8_t *p = buf;
+    
+    while (len) {
+        ssize_t n = read(fd, p, len);
+        
+        if (n <= 0)
+            return -1;
+        p += n;
+        len -= n;
+    }
+    return 0;
+}
+
+static void stream_hdr_to_host(struct fbstream_hdr *hdr) {
+    hdr->magic = le32toh(hdr->magic);
+    hdr->type = le16toh(hdr->type);
+    hdr->tile_size = le16toh(hdr->tile_size);
+    hdr->seq = le32toh(hdr->seq);
+    hdr->xres = le32toh(hdr->xres);
+    hdr->yres = le32toh(hdr->yres);
+    hdr->bits_per_pixel = le32toh(hdr->bits_per_pixel);
+    hdr->line_length = le32toh(hdr->line_length);
+    hdr->frame_len = le32toh(hdr->frame_len);
+    hdr->payload_len = le32toh(hdr->payload_len);
+}
+
+// Copy little-endian pixels from the stream into host order
+static void stream_get_pixels(uint8_t *dst, const uint8_t *src, size_t len,
+                              uint32_t bpp) {
+    size_t i;
+    
+    if (bpp == 32) {
+        for (i = 0; i < len; i += 4) {
+            uint32_t v;
+            
+            memcpy(&v, src + i, 4);
+            v = le32toh(v);
+            memcpy(dst + i, &v, 4);
+        }
+    } else if (bpp == 16) {
+        for (i = 0; i < len; i += 2) {
+            uint16_t v;
+            
+            memcpy(&v, src + i, 2);
+            v = le16toh(v);
+            memcpy(dst + i, &v, 2);
+        }
+    } else {
+        memcpy(dst, src, len);
+    }
+}
+
+// Apply one frame's tile ops to frame; returns 0 if the payload was well formed
+static int stream_decode(uint8_t *frame, const struct fbstream_hdr *hdr,
+                         const uint8_t *payload) {
+    const uint8_t *p = payload, *end = payload + hdr->payload_len;
+    size_t off = 0, tile = hdr->tile_size;
+    uint32_t bpp = hdr->bits_per_pixel;
+    
+    while (p + 4 <= end) {
+        uint32_t word, op, count, i, j;
+        uint8_t fill[4];
+        
+        memcpy(&word, p, 4);
+        word = le32toh(word);
+        p += 4;
+        op = word >> FBSTREAM_OP_SHIFT;
+        count = word & ((1U << FBSTREAM_OP_SHIFT) - 1);
+        if (off + (size_t)count * tile > hdr->frame_len)
+            return -1;
+        
+        switch (op) {
+        case FBSTREAM_OP_SKIP:
+            break;
+        case FBSTREAM_OP_FILL:
+            if (p + 4 > end)
+                return -1;
+            stream_get_pixels(fill, p, 4, bpp);
+            p += 4;
+            for (i = 0; i < count; i++)
+                for (j = 0; j < tile; j += 4)
+                    memcpy(frame + off + i * tile + j, fill, 4);
+            break;
+        case FBSTREAM_OP_RAW:
+            if (p + (size_t)count * tile > end)
+                return -1;
+            stream_get_pixels(frame + off, p, count * tile, bpp);
+            p += count * tile;
+            break;
+        default:
+            return -1;
+        }
+        off += (size_t)count * tile;
+    }
+    return off == hdr->frame_len ? 0 : -1;
+}
+
+// Read one frame's header and payload; returns 0 on success
+static int stream_read_frame(int fd, struct fbstream_hdr *hdr,
+                             uint8_t **payload) {
+    uint8_t *p;
+    
+    if (read_full(fd, hdr, sizeof(*hdr)) < 0)
+        return -1;
+    stream_hdr_to_host(hdr);
+    if (hdr->magic != FBSTREAM_MAGIC)
+        return -1;
+    p = realloc(*payload, hdr->payload_len);
+    if (!p)
+        return -1;
+    *payload = p;
+    return read_full(fd, p, hdr->payload_len);
+}
+
+void test_stream(struct framebuffer *fb) {
+    struct fbstream_hdr hdr;
+    struct fb_var_screeninfo var;
+    struct pollfd pfd;
+    uint8_t *frame = NULL, *payload = NULL, *mem;
+    uint8_t byte;
+    uint32_t pixel;
+    size_t visible, start;
+    int fd, i, ok;
+    
+    printf("Reading compressed stream from %s...\n", FBSTREAM_DEVICE);
+    
+    fd = open(FBSTREAM_DEVICE, O_RDONLY);
+    if (fd < 0) {
+        perror("Error opening stream device");
+        return;
+    }
+    
+    // fill_rect() draws from the top of the buffer, so show that part
+    ioctl(fb->fd, FBIOGET_VSCREENINFO, &var);
+    var.yoffset = 0;
+    ioctl(fb->fd, FBIOPAN_DISPLAY, &var);
+    
+    // The stream covers the panned window, so compare against all of memory
+    mem = mmap(NULL, fb->finfo.smem_len, PROT_READ, MAP_SHARED, fb->fd, 0);
+    if (mem == MAP_FAILED) {
+        perror("Error mapping framebuffer memory");
+        close(fd);
+        return;
+    }
+    
+    for (i = 0; i < 8; i++) {
+        // Change a little between frames so the deltas have something in them
+        if (i > 0)
+            fill_rect(fb, 40 * i, 40 * i, 64, 32, 0xFF000000 | (i * 0x203040));
+        
+        if (stream_read_frame(fd, &hdr, &payload) < 0) {
+            printf("Bad or short stream frame\n");
+            break;
+        }
+        frame = realloc(frame, hdr.frame_len);
+        if (!frame) {
+            printf("Out of memory\n");
+            break;
+        }
+        if (stream_decode(frame, &hdr, payload) < 0) {
+            printf("Frame %u: malformed payload\n", hdr.seq);
+            break;
+        }
+        
+        ioctl(fb->fd, FBIOGET_VSCREENINFO, &var);
+        start = (size_t)var.yoffset * hdr.line_length;
+        visible = (size_t)hdr.line_length * hdr.yres;
+        printf("  frame %u %-5s %8u bytes (%5.1f%% of raw) %s\n", hdr.seq,
+               hdr.type == FBSTREAM_KEYFRAME ? "key" : "delta",
+               hdr.payload_len, 100.0 * hdr.payload_len / hdr.frame_len,
+               start + visible <= fb->finfo.smem_len &&
+               !memcmp(frame, mem + start, visible) ? "match" : "MISMATCH");
+    }
+    
+    // Nothing drawn since the last frame: no frame to send
+    fcntl(fd, F_SETFL, O_NONBLOCK);
+    ok = read(fd, &byte, 1) < 0 && errno == EAGAIN;
+    printf("  unchanged frame, non-blocking read: %s\n",
+           ok ? "EAGAIN" : "FAILED");
+    
+    // Drawing through the mapping is found by the periodic recheck
+    ioctl(fb->fd, FBIOGET_VSCREENINFO, &var);
+    memcpy(&pixel, mem + (size_t)var.yoffset * fb->finfo.line_length, 4);
+    fill_rect(fb, 0, 0, 64, 64, pixel ^ 0x00FFFFFF);
+    pfd.fd = fd;
+    pfd.events = POLLIN;
+    ok = poll(&pfd, 1, 1000) == 1 && (pfd.revents & POLLIN) &&
+         stream_read_frame(fd, &hdr, &payload) == 0;
+    printf("  poll after mmap drawing: %s\n", ok ? "frame ready" : "FAILED");
+    
+    free(frame);
+    free(payload);
+    munmap(mem, fb->finfo.smem_len);
+    close(fd);
+}
+
 int main(int argc, char *argv[]) {
     struct framebuffer fb;
     int test_num = 0;
@@ -276,6 +665,14 @@ int main(int argc, char *argv[]) {
         test_animation(&fb);
         break;
         
+    case 5:
+        test_tlb_bench(&fb);
+        break;
+        
+    case 6:
+        test_stream(&fb);
+        break;
+        
     default:
         printf("Unknown test number\n");
         printf("Usage: %s [test_number]\n", argv[0]);
@@ -284,6 +681,8 @@ int main(int argc, char *argv[]) {
         printf("  2 - Gradient\n");
         printf("  3 - Shapes\n");
         printf("  4 - Animation\n");
+        printf("  5 - Memory walk / TLB benchmark\n");
+        printf("  6 - Compressed stream export\n");
         break;
     }
     
@@ -3,41 +3,1478 @@
 #include <linux/platform_device.h>
 #include <linux/pm.h>
 #include <linux/of.h>
+#include <linux/ktime.h>
+#include <linux/log2.h>
+#include <linux/spinlock.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+#include <linux/device.h>
+#include <linux/regmap.h>
+#include <linux/slab.h>
+#include <linux/uaccess.h>
+#include <linux/pm_runtime.h>
+#include <linux/kthread.h>
+#include <linux/rwsem.h>
+#include <linux/mutex.h>
+#include <linux/atomic.h>
+#include <linux/sort.h>
+#include <linux/mm.h>
+#include <linux/pm_qos.h>
+#include <linux/workqueue.h>
+#include <linux/build_bug.h>
+
+#define CREATE_TRACE_POINTS
+#include "pm_hooks_trace.h"
 
 #define DRIVER_NAME "pm_hooks_demo"
 
-static int pm_demo_probe(struct platform_device *pdev)
+/*
+ * Simulated MMIO block. Registers are 32-bit at a 4-byte stride; the
+ * reset values written by pm_demo_hw_reset() double as regcache defaults.
+ */
+#define PM_DEMO_REG_ID       0x000
+#define PM_DEMO_REG_CTRL     0x004
+#define PM_DEMO_REG_IRQ_EN   0x008
+#define PM_DEMO_REG_CFG(n)   (0x100 + (n) * 4)
+#define PM_DEMO_NR_CFG       64
+#define PM_DEMO_MMIO_SIZE    0x200
+
+#define PM_DEMO_ID_VALUE     0x504d0100
+#define PM_DEMO_CTRL_ENABLE  BIT(0)
+
+#define PM_DEMO_AUTOSUSPEND_MS     100
+#define PM_DEMO_AUTOSUSPEND_BUSY_MS 1000
+#define PM_DEMO_AUTOSUSPEND_IDLE_MS 10
+#define PM_DEMO_MAX_SIM_DEVICES    8
+#define PM_DEMO_STRESS_MAX_CYCLES  100000
+#define PM_DEMO_STRESS_MAX_THREADS 64
+/* A cycle window whose I/O rate is below this share of the mean is a dip */
+#define PM_DEMO_STRESS_DIP_PCT     50
+
+/* Load monitor: PM_DEMO_LOAD_WINDOW samples, one every PM_DEMO_LOAD_SAMPLE_MS */
+#define PM_DEMO_LOAD_SAMPLE_MS     25
+#define PM_DEMO_LOAD_WINDOW        8
+#define PM_DEMO_LOAD_HISTORY       16
+#define PM_DEMO_LOAD_BUSY_OPS      5000
+#define PM_DEMO_LOAD_IDLE_OPS      50
+#define PM_DEMO_LOAD_BUSY_DEPTH    2
+
+/* log2 buckets in microseconds: bucket i holds [2^i, 2^(i+1)) us */
+#define PM_DEMO_HIST_BUCKETS 24
+
+/*
+ * Every callback we time gets a slot here. Transitions towards a low power
+ * state come first (up to PM_DEMO_LAST_DOWN), transitions back follow up
+ * to complete. Runtime PM callbacks are timed but stay out of the system
+ * totals. The two *_TOTAL entries are end-to-end figures: first down-side
+ * callback to the *_noirq exit, and first up-side callback to complete exit.
+ */
+enum pm_demo_phase {
+    PM_DEMO_PREPARE,
+    PM_DEMO_SUSPEND,
+    PM_DEMO_SUSPEND_LATE,
+    PM_DEMO_SUSPEND_NOIRQ,
+    PM_DEMO_FREEZE,
+    PM_DEMO_FREEZE_LATE,
+    PM_DEMO_FREEZE_NOIRQ,
+    PM_DEMO_POWEROFF,
+    PM_DEMO_POWEROFF_LATE,
+    PM_DEMO_POWEROFF_NOIRQ,
+    PM_DEMO_LAST_DOWN = PM_DEMO_POWEROFF_NOIRQ,
+    PM_DEMO_RESUME_NOIRQ,
+    PM_DEMO_RESUME_EARLY,
+    PM_DEMO_RESUME,
+    PM_DEMO_THAW_NOIRQ,
+    PM_DEMO_THAW_EARLY,
+    PM_DEMO_THAW,
+    PM_DEMO_RESTORE_NOIRQ,
+    PM_DEMO_RESTORE_EARLY,
+    PM_DEMO_RESTORE,
+    PM_DEMO_COMPLETE,
+    PM_DEMO_RUNTIME_SUSPEND,
+    PM_DEMO_RUNTIME_RESUME,
+    PM_DEMO_SUSPEND_TOTAL,
+    PM_DEMO_RESUME_TOTAL,
+    PM_DEMO_NR_PHASES,
+};
+
+static const char * const pm_demo_phase_names[PM_DEMO_NR_PHASES] = {
+    [PM_DEMO_PREPARE]        = "prepare",
+    [PM_DEMO_SUSPEND]        = "suspend",
+    [PM_DEMO_SUSPEND_LATE]   = "suspend_late",
+    [PM_DEMO_SUSPEND_NOIRQ]  = "suspend_noirq",
+    [PM_DEMO_FREEZE]         = "freeze",
+    [PM_DEMO_FREEZE_LATE]    = "freeze_late",
+    [PM_DEMO_FREEZE_NOIRQ]   = "freeze_noirq",
+    [PM_DEMO_POWEROFF]       = "poweroff",
+    [PM_DEMO_POWEROFF_LATE]  = "poweroff_late",
+    [PM_DEMO_POWEROFF_NOIRQ] = "poweroff_noirq",
+    [PM_DEMO_RESUME_NOIRQ]   = "resume_noirq",
+    [PM_DEMO_RESUME_EARLY]   = "resume_early",
+    [PM_DEMO_RESUME]         = "resume",
+    [PM_DEMO_THAW_NOIRQ]     = "thaw_noirq",
+    [PM_DEMO_THAW_EARLY]     = "thaw_early",
+    [PM_DEMO_THAW]           = "thaw",
+    [PM_DEMO_RESTORE_NOIRQ]  = "restore_noirq",
+    [PM_DEMO_RESTORE_EARLY]  = "restore_early",
+    [PM_DEMO_RESTORE]        = "restore",
+    [PM_DEMO_COMPLETE]       = "complete",
+    [PM_DEMO_RUNTIME_SUSPEND] = "runtime_suspend",
+    [PM_DEMO_RUNTIME_RESUME] = "runtime_resume",
+    [PM_DEMO_SUSPEND_TOTAL]  = "suspend_total",
+    [PM_DEMO_RESUME_TOTAL]   = "resume_total",
+};
+
+struct pm_demo_stats {
+    u64 count;
+    u64 total_ns;
+    u64 min_ns;
+    u64 max_ns;
+    u64 last_ns;
+    u64 hist[PM_DEMO_HIST_BUCKETS];
+};
+// Readers copy one of these onto the stack per phase, never the whole array
+static_assert(sizeof(struct pm_demo_stats) <= 256);
+
+enum pm_demo_load_state {
+    PM_DEMO_LOAD_IDLE,
+    PM_DEMO_LOAD_MODERATE,
+    PM_DEMO_LOAD_BUSY,
+};
+
+static const char * const pm_demo_load_names[] = {
+    [PM_DEMO_LOAD_IDLE]     = "idle",
+    [PM_DEMO_LOAD_MODERATE] = "moderate",
+    [PM_DEMO_LOAD_BUSY]     = "busy",
+};
+
+struct pm_demo_load_sample {
+    u32 ops_per_s;
+    u32 depth_x100;             // Mean queue depth seen by arrivals, x100
+};
+
+struct pm_demo_load_decision {
+    u64 ts_ms;
+    enum pm_demo_load_state state;
+    struct pm_demo_load_sample trigger;
+    s32 qos_us;
+    int autosuspend_ms;
+};
+
+struct pm_demo_stress_report {
+    u32 cycles;
+    u32 threads;
+    u32 runtime_cycles;
+    u32 system_cycles;
+    u32 failures;
+    u32 qos_blocked;            // Runtime cycles refused by an outside QoS request
+    u64 elapsed_ns;
+    u64 io_ops;
+    u64 tput_mean;              // I/O ops per second, averaged over windows
+    u64 tput_min;
+    u32 dips;                   // Windows below PM_DEMO_STRESS_DIP_PCT of mean
+    u64 resume_p50_ns;
+    u64 resume_p99_ns;
+    u64 resume_p999_ns;
+    u64 resume_max_ns;
+};
+
+struct pm_demo_priv {
+    struct device *dev;
+    spinlock_t stats_lock;      // Protects stats[] against debugfs/sysfs readers
+    struct pm_demo_stats stats[PM_DEMO_NR_PHASES];
+    ktime_t suspend_start;      // 0 when no suspend transition is in flight
+    ktime_t resume_start;       // 0 when no resume transition is in flight
+    bool context_saved;         // Set by save_context, consumed by restore
+    u32 *mmio;                  // Simulated register block
+    struct regmap *map;         // rbtree-cached view of mmio
+    u64 bus_writes;             // Raw bus transactions issued
+    u64 bus_regs;               // Registers carried by those transactions
+    u64 sync_writes;            // Bus transactions in the last regcache_sync
+    u64 sync_regs;              // Registers written by the last regcache_sync
+    struct rw_semaphore io_sem; // Held for write to fence off I/O
+    bool io_quiesced;           // io_sem held for write from freeze to thaw
+    atomic64_t io_ops;          // Completed simulated I/O operations
+    atomic_t io_inflight;       // Current queue depth
+    atomic64_t io_depth_sum;    // Sum of queue depth seen by each arrival
+    struct mutex stress_lock;   // One stress run at a time, guards report
+    struct dentry *debugfs_dir;
+    struct pm_demo_stress_report report;
+
+    /* Load monitor, all under load_lock except the atomics */
+    struct delayed_work load_work;
+    atomic_t load_active;       // Sampling work is scheduled
+    bool load_rebase;           // Next sample only re-baselines counters
+    bool load_paused;           // Stress run in progress, QoS hold dropped
+    struct mutex load_lock;
+    struct dev_pm_qos_request qos_req;
+    u64 load_last_ops;
+    u64 load_last_depth_sum;
+    ktime_t load_last_ts;
+    struct pm_demo_load_sample load_win[PM_DEMO_LOAD_WINDOW];
+    unsigned int load_win_pos;
+    unsigned int load_win_fill;
+    enum pm_demo_load_state load_state;
+    u32 load_busy_ops;
+    u32 load_idle_ops;
+    u32 load_busy_depth;
+    struct pm_demo_load_decision load_hist[PM_DEMO_LOAD_HISTORY];
+    unsigned int load_hist_pos;
+    unsigned int load_hist_fill;
+};
+
+static struct dentry *pm_demo_debugfs_root;
+
+static unsigned int sim_devices;
+module_param(sim_devices, uint, 0444);
+MODULE_PARM_DESC(sim_devices,
+                 "Number of simulated devices to create without DT (max 8)");
+
+static struct platform_device *pm_demo_sim_pdev[PM_DEMO_MAX_SIM_DEVICES];
+
+/* -------- Latency Accounting -------- */
+static void pm_demo_stats_reset(struct pm_demo_priv *priv)
 {
-    dev_info(&pdev->dev, "PM Demo Driver Probed\n");
+    unsigned long flags;
+    int i;
+
+    spin_lock_irqsave(&priv->stats_lock, flags);
+    memset(priv->stats, 0, sizeof(priv->stats));
+    for (i = 0; i < PM_DEMO_NR_PHASES; i++)
+        priv->stats[i].min_ns = U64_MAX;
+    spin_unlock_irqrestore(&priv->stats_lock, flags);
+}
+
+static void pm_demo_stats_add(struct pm_demo_priv *priv,
+                              enum pm_demo_phase phase, u64 delta_ns)
+{
+    struct pm_demo_stats *st = &priv->stats[phase];
+    u64 us = div_u64(delta_ns, NSEC_PER_USEC);
+    unsigned int bucket = us ? ilog2(us) : 0;
+    unsigned long flags;
+
+    if (bucket >= PM_DEMO_HIST_BUCKETS)
+        bucket = PM_DEMO_HIST_BUCKETS - 1;
+
+    spin_lock_irqsave(&priv->stats_lock, flags);
+    st->count++;
+    st->total_ns += delta_ns;
+    st->last_ns = delta_ns;
+    if (delta_ns < st->min_ns)
+        st->min_ns = delta_ns;
+    if (delta_ns > st->max_ns)
+        st->max_ns = delta_ns;
+    st->hist[bucket]++;
+    spin_unlock_irqrestore(&priv->stats_lock, flags);
+}
+
+static ktime_t pm_demo_phase_begin(struct pm_demo_priv *priv,
+                                   enum pm_demo_phase phase)
+{
+    ktime_t now = ktime_get();
+
+    if (phase <= PM_DEMO_LAST_DOWN) {
+        if (!priv->suspend_start)
+            priv->suspend_start = now;
+    } else if (phase <= PM_DEMO_COMPLETE && !priv->resume_start) {
+        priv->resume_start = now;
+    }
+
+    trace_pm_demo_phase(priv->dev, pm_demo_phase_names[phase], true, 0);
+    return now;
+}
+
+static void pm_demo_phase_end(struct pm_demo_priv *priv,
+                              enum pm_demo_phase phase, ktime_t start)
+{
+    ktime_t now = ktime_get();
+    u64 delta_ns = ktime_to_ns(ktime_sub(now, start));
+
+    pm_demo_stats_add(priv, phase, delta_ns);
+    trace_pm_demo_phase(priv->dev, pm_demo_phase_names[phase], false, delta_ns);
+
+    if ((phase == PM_DEMO_SUSPEND_NOIRQ || phase == PM_DEMO_FREEZE_NOIRQ ||
+         phase == PM_DEMO_POWEROFF_NOIRQ) && priv->suspend_start) {
+        pm_demo_stats_add(priv, PM_DEMO_SUSPEND_TOTAL,
+                          ktime_to_ns(ktime_sub(now, priv->suspend_start)));
+        priv->suspend_start = 0;
+    } else if (phase == PM_DEMO_COMPLETE && priv->resume_start) {
+        pm_demo_stats_add(priv, PM_DEMO_RESUME_TOTAL,
+                          ktime_to_ns(ktime_sub(now, priv->resume_start)));
+        priv->resume_start = 0;
+        /* An aborted transition never reaches the *_noirq phase */
+        priv->suspend_start = 0;
+    }
+}
+
+/* -------- Simulated Register Block -------- */
+
+// What the block looks like after power-on or after losing its rail
+static void pm_demo_hw_reset(struct pm_demo_priv *priv)
+{
+    memset(priv->mmio, 0, PM_DEMO_MMIO_SIZE);
+    priv->mmio[PM_DEMO_REG_ID / 4] = PM_DEMO_ID_VALUE;
+    priv->mmio[PM_DEMO_REG_CTRL / 4] = PM_DEMO_CTRL_ENABLE;
+}
+
+/*
+ * Minimal regmap bus over the simulated block. Providing raw writes lets
+ * regcache_sync() coalesce runs of adjacent dirty registers into a single
+ * transaction instead of one write per register.
+ */
+static int pm_demo_bus_gather_write(void *context,
+                                    const void *reg_buf, size_t reg_size,
+                                    const void *val_buf, size_t val_size)
+{
+    struct pm_demo_priv *priv = context;
+    u32 reg = *(const u32 *)reg_buf;
+
+    if (reg_size != sizeof(u32) || reg + val_size > PM_DEMO_MMIO_SIZE)
+        return -EINVAL;
+
+    memcpy((u8 *)priv->mmio + reg, val_buf, val_size);
+    priv->bus_writes++;
+    priv->bus_regs += val_size / sizeof(u32);
     return 0;
 }
 
-static int pm_demo_remove(struct platform_device *pdev)
+static int pm_demo_bus_write(void *context, const void *data, size_t count)
 {
-    dev_info(&pdev->dev, "PM Demo Driver Removed\n");
+    if (count < sizeof(u32))
+        return -EINVAL;
+
+    return pm_demo_bus_gather_write(context, data, sizeof(u32),
+                                    (const u8 *)data + sizeof(u32),
+                                    count - sizeof(u32));
+}
+
+static int pm_demo_bus_read(void *context,
+                            const void *reg_buf, size_t reg_size,
+                            void *val_buf, size_t val_size)
+{
+    struct pm_demo_priv *priv = context;
+    u32 reg = *(const u32 *)reg_buf;
+
+    if (reg_size != sizeof(u32) || reg + val_size > PM_DEMO_MMIO_SIZE)
+        return -EINVAL;
+
+    memcpy(val_buf, (u8 *)priv->mmio + reg, val_size);
+    return 0;
+}
+
+static const struct regmap_bus pm_demo_regmap_bus = {
+    .write        = pm_demo_bus_write,
+    .gather_write = pm_demo_bus_gather_write,
+    .read         = pm_demo_bus_read,
+};
+
+static bool pm_demo_writeable_reg(struct device *dev, unsigned int reg)
+{
+    return reg != PM_DEMO_REG_ID;
+}
+
+static const struct regmap_config pm_demo_regmap_config = {
+    .reg_bits          = 32,
+    .val_bits          = 32,
+    .reg_stride        = 4,
+    .max_register      = PM_DEMO_MMIO_SIZE - 4,
+    .writeable_reg     = pm_demo_writeable_reg,
+    .reg_format_endian = REGMAP_ENDIAN_NATIVE,
+    .val_format_endian = REGMAP_ENDIAN_NATIVE,
+    .cache_type        = REGCACHE_RBTREE,
+    /* Read reset defaults back from the block at init */
+    .num_reg_defaults_raw = PM_DEMO_MMIO_SIZE / 4,
+};
+
+static int pm_demo_regs_init(struct pm_demo_priv *priv)
+{
+    priv->mmio = devm_kzalloc(priv->dev, PM_DEMO_MMIO_SIZE, GFP_KERNEL);
+    if (!priv->mmio)
+        return -ENOMEM;
+
+    pm_demo_hw_reset(priv);
+
+    priv->map = devm_regmap_init(priv->dev, &pm_demo_regmap_bus, priv,
+                                 &pm_demo_regmap_config);
+    return PTR_ERR_OR_ZERO(priv->map);
+}
+
+/*
+ * Writes go through the cache to the block, so the cache always mirrors
+ * the live state and there is nothing to read back at suspend time.
+ */
+static int pm_demo_reg_write(struct pm_demo_priv *priv, unsigned int reg,
+                             unsigned int val)
+{
+    return regmap_write(priv->map, reg, val);
+}
+
+/* -------- Load Monitor -------- */
+
+/*
+ * Busy: a resume latency of 0 stops runtime PM from suspending at all, so
+ * requests never wait for a wake-up. Idle: no constraint and a short
+ * autosuspend delay so the block powers down almost as soon as it drains.
+ */
+static const s32 pm_demo_load_qos_us[] = {
+    [PM_DEMO_LOAD_IDLE]     = PM_QOS_RESUME_LATENCY_NO_CONSTRAINT,
+    [PM_DEMO_LOAD_MODERATE] = PM_QOS_RESUME_LATENCY_NO_CONSTRAINT,
+    [PM_DEMO_LOAD_BUSY]     = 0,
+};
+
+static const int pm_demo_load_autosuspend_ms[] = {
+    [PM_DEMO_LOAD_IDLE]     = PM_DEMO_AUTOSUSPEND_IDLE_MS,
+    [PM_DEMO_LOAD_MODERATE] = PM_DEMO_AUTOSUSPEND_MS,
+    [PM_DEMO_LOAD_BUSY]     = PM_DEMO_AUTOSUSPEND_BUSY_MS,
+};
+
+static void pm_demo_load_apply(struct pm_demo_priv *priv,
+                               enum pm_demo_load_state next,
+                               const struct pm_demo_load_sample *trigger)
+{
+    struct pm_demo_load_decision *d = &priv->load_hist[priv->load_hist_pos];
+
+    if (!priv->load_paused)
+        dev_pm_qos_update_request(&priv->qos_req, pm_demo_load_qos_us[next]);
+    pm_runtime_set_autosuspend_delay(priv->dev,
+                                     pm_demo_load_autosuspend_ms[next]);
+
+    /* Runtime PM does not re-check QoS by itself once the hold is lifted */
+    if (priv->load_state == PM_DEMO_LOAD_BUSY)
+        pm_request_autosuspend(priv->dev);
+
+    priv->load_state = next;
+
+    d->ts_ms = ktime_to_ms(ktime_get());
+    d->state = next;
+    d->trigger = *trigger;
+    d->qos_us = pm_demo_load_qos_us[next];
+    d->autosuspend_ms = pm_demo_load_autosuspend_ms[next];
+    priv->load_hist_pos = (priv->load_hist_pos + 1) % PM_DEMO_LOAD_HISTORY;
+    if (priv->load_hist_fill < PM_DEMO_LOAD_HISTORY)
+        priv->load_hist_fill++;
+}
+
+static bool pm_demo_load_sample_busy(struct pm_demo_priv *priv,
+                                     const struct pm_demo_load_sample *sample)
+{
+    return sample->ops_per_s >= priv->load_busy_ops ||
+           sample->depth_x100 >= priv->load_busy_depth * 100;
+}
+
+/*
+ * Go busy on a single busy sample, but only leave busy once no sample in
+ * the window is busy by either rate or depth. Idle needs the whole window
+ * quiet too.
+ */
+static enum pm_demo_load_state pm_demo_load_decide(struct pm_demo_priv *priv,
+                                    const struct pm_demo_load_sample *cur)
+{
+    bool any_busy = false;
+    u32 max_ops = 0;
+    unsigned int i;
+
+    if (pm_demo_load_sample_busy(priv, cur))
+        return PM_DEMO_LOAD_BUSY;
+
+    for (i = 0; i < priv->load_win_fill; i++) {
+        max_ops = max(max_ops, priv->load_win[i].ops_per_s);
+        any_busy |= pm_demo_load_sample_busy(priv, &priv->load_win[i]);
+    }
+
+    if (priv->load_state == PM_DEMO_LOAD_BUSY && any_busy)
+        return PM_DEMO_LOAD_BUSY;
+    if (max_ops < priv->load_idle_ops)
+        return PM_DEMO_LOAD_IDLE;
+    return PM_DEMO_LOAD_MODERATE;
+}
+
+static void pm_demo_load_work_fn(struct work_struct *work)
+{
+    struct pm_demo_priv *priv = container_of(to_delayed_work(work),
+                                             struct pm_demo_priv, load_work);
+    struct pm_demo_load_sample *cur;
+    enum pm_demo_load_state next;
+    u64 ops = atomic64_read(&priv->io_ops);
+    u64 depth_sum = atomic64_read(&priv->io_depth_sum);
+    ktime_t now = ktime_get();
+    u64 dt_ns, dops;
+    bool quiet;
+
+    mutex_lock(&priv->load_lock);
+
+    dt_ns = ktime_to_ns(ktime_sub(now, priv->load_last_ts));
+    dops = ops - priv->load_last_ops;
+    quiet = !dops;
+
+    if (priv->load_rebase) {
+        /* Sampling just restarted; the gap since the last sample is idle time */
+        priv->load_rebase = false;
+        goto rebase;
+    }
+
+    cur = &priv->load_win[priv->load_win_pos];
+    cur->ops_per_s = dt_ns ? div64_u64(dops * NSEC_PER_SEC, dt_ns) : 0;
+    cur->depth_x100 = dops ? div64_u64((depth_sum - priv->load_last_depth_sum) * 100,
+                                       dops) : 0;
+    priv->load_win_pos = (priv->load_win_pos + 1) % PM_DEMO_LOAD_WINDOW;
+    if (priv->load_win_fill < PM_DEMO_LOAD_WINDOW)
+        priv->load_win_fill++;
+
+    next = pm_demo_load_decide(priv, cur);
+    if (next != priv->load_state)
+        pm_demo_load_apply(priv, next, cur);
+
+rebase:
+    priv->load_last_ops = ops;
+    priv->load_last_depth_sum = depth_sum;
+    priv->load_last_ts = now;
+
+    /* Nothing to watch: stop sampling until the next request kicks us */
+    if (priv->load_state == PM_DEMO_LOAD_IDLE && quiet) {
+        priv->load_rebase = true;
+        mutex_unlock(&priv->load_lock);
+
+        atomic_set(&priv->load_active, 0);
+        smp_mb__after_atomic();
+        if (atomic64_read(&priv->io_ops) == ops ||
+            atomic_xchg(&priv->load_active, 1))
+            return;
+    } else {
+        mutex_unlock(&priv->load_lock);
+    }
+
+    queue_delayed_work(system_freezable_power_efficient_wq, &priv->load_work,
+                       msecs_to_jiffies(PM_DEMO_LOAD_SAMPLE_MS));
+}
+
+/*
+ * The stress harness drives runtime suspends itself, and a busy hold would
+ * refuse every one of them with -EPERM. Drop the hold for the length of a
+ * run; the monitor keeps sampling and deciding, and the constraint for its
+ * current state is put back afterwards.
+ */
+static void pm_demo_load_pause(struct pm_demo_priv *priv, bool pause)
+{
+    mutex_lock(&priv->load_lock);
+    priv->load_paused = pause;
+    dev_pm_qos_update_request(&priv->qos_req,
+                              pause ? PM_QOS_RESUME_LATENCY_NO_CONSTRAINT :
+                                      pm_demo_load_qos_us[priv->load_state]);
+    mutex_unlock(&priv->load_lock);
+}
+
+static void pm_demo_load_kick(struct pm_demo_priv *priv)
+{
+    if (atomic_read(&priv->load_active) || atomic_xchg(&priv->load_active, 1))
+        return;
+
+    queue_delayed_work(system_freezable_power_efficient_wq, &priv->load_work,
+                       msecs_to_jiffies(PM_DEMO_LOAD_SAMPLE_MS));
+}
+
+static int pm_demo_load_init(struct pm_demo_priv *priv)
+{
+    int ret;
+
+    mutex_init(&priv->load_lock);
+    INIT_DELAYED_WORK(&priv->load_work, pm_demo_load_work_fn);
+    priv->load_state = PM_DEMO_LOAD_MODERATE;
+    priv->load_rebase = true;
+    priv->load_busy_ops = PM_DEMO_LOAD_BUSY_OPS;
+    priv->load_idle_ops = PM_DEMO_LOAD_IDLE_OPS;
+    priv->load_busy_depth = PM_DEMO_LOAD_BUSY_DEPTH;
+
+    ret = dev_pm_qos_add_request(priv->dev, &priv->qos_req,
+                                 DEV_PM_QOS_RESUME_LATENCY,
+                                 PM_QOS_RESUME_LATENCY_NO_CONSTRAINT);
+    return ret < 0 ? ret : 0;
+}
+
+static void pm_demo_load_exit(struct pm_demo_priv *priv)
+{
+    cancel_delayed_work_sync(&priv->load_work);
+    dev_pm_qos_remove_request(&priv->qos_req);
+}
+
+/* -------- Simulated I/O Path -------- */
+
+/*
+ * One I/O request: wake the block if needed, touch a config register and
+ * let autosuspend power it back down once traffic stops.
+ */
+static int pm_demo_do_io(struct pm_demo_priv *priv)
+{
+    u64 n = atomic64_read(&priv->io_ops);
+    int ret;
+
+    /* Count requests stuck behind an I/O fence as queued too */
+    atomic64_add(atomic_inc_return(&priv->io_inflight), &priv->io_depth_sum);
+    pm_demo_load_kick(priv);
+
+    down_read(&priv->io_sem);
+
+    ret = pm_runtime_resume_and_get(priv->dev);
+    if (!ret) {
+        ret = pm_demo_reg_write(priv, PM_DEMO_REG_CFG(n % PM_DEMO_NR_CFG),
+                                lower_32_bits(n));
+        pm_runtime_mark_last_busy(priv->dev);
+        pm_runtime_put_autosuspend(priv->dev);
+    }
+
+    up_read(&priv->io_sem);
+    atomic_dec(&priv->io_inflight);
+
+    if (!ret)
+        atomic64_inc(&priv->io_ops);
+    return ret;
+}
+
+/* -------- Debugfs / Sysfs Export -------- */
+static void pm_demo_stats_snapshot(struct pm_demo_priv *priv,
+                                   enum pm_demo_phase phase,
+                                   struct pm_demo_stats *snap)
+{
+    unsigned long flags;
+
+    spin_lock_irqsave(&priv->stats_lock, flags);
+    *snap = priv->stats[phase];
+    spin_unlock_irqrestore(&priv->stats_lock, flags);
+}
+
+static int pm_demo_latency_show(struct seq_file *s, void *unused)
+{
+    struct pm_demo_priv *priv = s->private;
+    struct pm_demo_stats st;    // One phase at a time keeps the stack small
+    int i, b;
+
+    seq_printf(s, "%-16s %10s %12s %12s %12s %12s\n",
+               "phase", "count", "last_ns", "min_ns", "avg_ns", "max_ns");
+    for (i = 0; i < PM_DEMO_NR_PHASES; i++) {
+        pm_demo_stats_snapshot(priv, i, &st);
+        seq_printf(s, "%-16s %10llu %12llu %12llu %12llu %12llu\n",
+                   pm_demo_phase_names[i], st.count, st.last_ns,
+                   st.count ? st.min_ns : 0,
+                   st.count ? div64_u64(st.total_ns, st.count) : 0,
+                   st.max_ns);
+    }
+
+    for (i = 0; i < PM_DEMO_NR_PHASES; i++) {
+        pm_demo_stats_snapshot(priv, i, &st);
+        if (!st.count)
+            continue;
+
+        seq_printf(s, "\n%s histogram (us):\n", pm_demo_phase_names[i]);
+        for (b = 0; b < PM_DEMO_HIST_BUCKETS; b++) {
+            if (!st.hist[b])
+                continue;
+            if (b == PM_DEMO_HIST_BUCKETS - 1)
+                seq_printf(s, "  [%8lu, inf) %llu\n", 1UL << b, st.hist[b]);
+            else
+                seq_printf(s, "  [%8lu, %8lu) %llu\n",
+                           b ? 1UL << b : 0UL, 1UL << (b + 1), st.hist[b]);
+        }
+    }
+
     return 0;
 }
+DEFINE_SHOW_ATTRIBUTE(pm_demo_latency);
+
+static int pm_demo_regcache_show(struct seq_file *s, void *unused)
+{
+    struct pm_demo_priv *priv = s->private;
+
+    seq_printf(s, "bus_writes:       %llu\n", priv->bus_writes);
+    seq_printf(s, "bus_regs:         %llu\n", priv->bus_regs);
+    seq_printf(s, "last_sync_writes: %llu\n", priv->sync_writes);
+    seq_printf(s, "last_sync_regs:   %llu\n", priv->sync_regs);
+    return 0;
+}
+DEFINE_SHOW_ATTRIBUTE(pm_demo_regcache);
+
+// "<reg> <val>" - stand-in for the driver reconfiguring the block at runtime
+static ssize_t pm_demo_reg_poke_write(struct file *file,
+                                      const char __user *ubuf,
+                                      size_t count, loff_t *ppos)
+{
+    struct pm_demo_priv *priv = file->private_data;
+    unsigned int reg, val;
+    char buf[32];
+    int ret;
+
+    if (count >= sizeof(buf))
+        return -EINVAL;
+    if (copy_from_user(buf, ubuf, count))
+        return -EFAULT;
+    buf[count] = '\0';
+
+    if (sscanf(buf, "%i %i", &reg, &val) != 2)
+        return -EINVAL;
+
+    ret = pm_demo_reg_write(priv, reg, val);
+    return ret ? ret : count;
+}
+
+static const struct file_operations pm_demo_reg_poke_fops = {
+    .owner  = THIS_MODULE,
+    .open   = simple_open,
+    .write  = pm_demo_reg_poke_write,
+    .llseek = no_llseek,
+};
+
+static u64 pm_demo_last_us(struct pm_demo_priv *priv, enum pm_demo_phase phase,
+                           bool max)
+{
+    unsigned long flags;
+    u64 ns;
+
+    spin_lock_irqsave(&priv->stats_lock, flags);
+    ns = max ? priv->stats[phase].max_ns : priv->stats[phase].last_ns;
+    spin_unlock_irqrestore(&priv->stats_lock, flags);
+
+    return div_u64(ns, NSEC_PER_USEC);
+}
+
+static ssize_t last_suspend_us_show(struct device *dev,
+                                    struct device_attribute *attr, char *buf)
+{
+    struct pm_demo_priv *priv = dev_get_drvdata(dev);
+
+    return sysfs_emit(buf, "%llu\n",
+                      pm_demo_last_us(priv, PM_DEMO_SUSPEND_TOTAL, false));
+}
+static DEVICE_ATTR_RO(last_suspend_us);
+
+static ssize_t last_resume_us_show(struct device *dev,
+                                   struct device_attribute *attr, char *buf)
+{
+    struct pm_demo_priv *priv = dev_get_drvdata(dev);
+
+    return sysfs_emit(buf, "%llu\n",
+                      pm_demo_last_us(priv, PM_DEMO_RESUME_TOTAL, false));
+}
+static DEVICE_ATTR_RO(last_resume_us);
+
+static ssize_t max_resume_us_show(struct device *dev,
+                                  struct device_attribute *attr, char *buf)
+{
+    struct pm_demo_priv *priv = dev_get_drvdata(dev);
+
+    return sysfs_emit(buf, "%llu\n",
+                      pm_demo_last_us(priv, PM_DEMO_RESUME_TOTAL, true));
+}
+static DEVICE_ATTR_RO(max_resume_us);
+
+// Any write clears all counters and histograms
+static ssize_t latency_reset_store(struct device *dev,
+                                   struct device_attribute *attr,
+                                   const char *buf, size_t count)
+{
+    pm_demo_stats_reset(dev_get_drvdata(dev));
+    return count;
+}
+static DEVICE_ATTR_WO(latency_reset);
+
+static ssize_t load_state_show(struct device *dev,
+                               struct device_attribute *attr, char *buf)
+{
+    struct pm_demo_priv *priv = dev_get_drvdata(dev);
+    const struct pm_demo_load_sample *last;
+    ssize_t len;
+
+    mutex_lock(&priv->load_lock);
+    last = &priv->load_win[(priv->load_win_pos + PM_DEMO_LOAD_WINDOW - 1) %
+                           PM_DEMO_LOAD_WINDOW];
+    len = sysfs_emit(buf, "%s ops_per_s=%u depth=%u.%02u\n",
+                     pm_demo_load_names[priv->load_state], last->ops_per_s,
+                     last->depth_x100 / 100, last->depth_x100 % 100);
+    mutex_unlock(&priv->load_lock);
+
+    return len;
+}
+static DEVICE_ATTR_RO(load_state);
+
+// Newest decision first, one per line
+static ssize_t load_history_show(struct device *dev,
+                                 struct device_attribute *attr, char *buf)
+{
+    struct pm_demo_priv *priv = dev_get_drvdata(dev);
+    ssize_t len = 0;
+    unsigned int i;
+
+    mutex_lock(&priv->load_lock);
+    for (i = 1; i <= priv->load_hist_fill; i++) {
+        const struct pm_demo_load_decision *d =
+            &priv->load_hist[(priv->load_hist_pos + PM_DEMO_LOAD_HISTORY - i) %
+                             PM_DEMO_LOAD_HISTORY];
+
+        len += sysfs_emit_at(buf, len,
+                             "%llu %s ops_per_s=%u depth=%u.%02u qos_us=%d autosuspend_ms=%d\n",
+                             d->ts_ms, pm_demo_load_names[d->state],
+                             d->trigger.ops_per_s, d->trigger.depth_x100 / 100,
+                             d->trigger.depth_x100 % 100, d->qos_us,
+                             d->autosuspend_ms);
+    }
+    mutex_unlock(&priv->load_lock);
+
+    return len;
+}
+static DEVICE_ATTR_RO(load_history);
+
+static ssize_t pm_demo_load_tunable_store(struct device *dev, u32 *field,
+                                          const char *buf, size_t count)
+{
+    struct pm_demo_priv *priv = dev_get_drvdata(dev);
+    u32 val;
+    int ret;
+
+    ret = kstrtou32(buf, 0, &val);
+    if (ret)
+        return ret;
+
+    mutex_lock(&priv->load_lock);
+    *field = val;
+    mutex_unlock(&priv->load_lock);
+
+    return count;
+}
+
+#define PM_DEMO_LOAD_TUNABLE(name)                                          \
+static ssize_t name##_show(struct device *dev,                              \
+                           struct device_attribute *attr, char *buf)        \
+{                                                                           \
+    struct pm_demo_priv *priv = dev_get_drvdata(dev);                       \
+                                                                            \
+    return sysfs_emit(buf, "%u\n", READ_ONCE(priv->name));                  \
+}                                                                           \
+static ssize_t name##_store(struct device *dev,                             \
+                            struct device_attribute *attr,                  \
+                            const char *buf, size_t count)                  \
+{                                                                           \
+    struct pm_demo_priv *priv = dev_get_drvdata(dev);                       \
+                                                                            \
+    return pm_demo_load_tunable_store(dev, &priv->name, buf, count);        \
+}                                                                           \
+static DEVICE_ATTR_RW(name)
+
+PM_DEMO_LOAD_TUNABLE(load_busy_ops);
+PM_DEMO_LOAD_TUNABLE(load_idle_ops);
+PM_DEMO_LOAD_TUNABLE(load_busy_depth);
+
+static struct attribute *pm_demo_attrs[] = {
+    &dev_attr_last_suspend_us.attr,
+    &dev_attr_last_resume_us.attr,
+    &dev_attr_max_resume_us.attr,
+    &dev_attr_latency_reset.attr,
+    &dev_attr_load_state.attr,
+    &dev_attr_load_history.attr,
+    &dev_attr_load_busy_ops.attr,
+    &dev_attr_load_idle_ops.attr,
+    &dev_attr_load_busy_depth.attr,
+    NULL,
+};
+ATTRIBUTE_GROUPS(pm_demo);
 
 /* -------- Power Management Hooks -------- */
-static int pm_demo_suspend(struct device *dev)
+
+/*
+ * Context save/restore is the expensive part of a transition, so it lives
+ * in the suspend/poweroff and resume/restore callbacks. Those run from the
+ * async PM threads; prepare and complete are always called synchronously
+ * and are kept trivial.
+ */
+static int pm_demo_save_context(struct pm_demo_priv *priv)
 {
-    dev_info(dev, "System is suspending... Saving context, disabling HW\n");
-    /* turn off clocks / interrupts / power rails here in real drivers */
+    /* Already down, e.g. runtime suspended before a system suspend */
+    if (priv->context_saved)
+        return 0;
+
+    dev_dbg(priv->dev, "Saving context, powering down HW\n");
+
+    /*
+     * The cache already holds every value we wrote, so "saving" is just
+     * fencing off the bus and noting that the block is about to lose
+     * state. The reset models the power rail going away.
+     */
+    regcache_cache_only(priv->map, true);
+    regcache_mark_dirty(priv->map);
+    pm_demo_hw_reset(priv);
+
+    priv->context_saved = true;
     return 0;
 }
 
-static int pm_demo_resume(struct device *dev)
+static int pm_demo_restore_context(struct pm_demo_priv *priv)
 {
-    dev_info(dev, "System resumed! Restoring hardware state...\n");
-    /* reinitialize clocks / restore registers / power on hardware */
+    u64 writes, regs;
+    int ret;
+
+    /*
+     * A device that was runtime suspended before the system transition
+     * stays down; the next runtime resume brings it back.
+     */
+    if (!priv->context_saved || pm_runtime_status_suspended(priv->dev))
+        return 0;
+
+    dev_dbg(priv->dev, "Restoring hardware context\n");
+
+    /*
+     * Only registers whose cached value differs from the reset default
+     * are written back, with adjacent ones batched into one transfer.
+     */
+    writes = priv->bus_writes;
+    regs = priv->bus_regs;
+    regcache_mark_dirty(priv->map);
+    regcache_cache_only(priv->map, false);
+    ret = regcache_sync(priv->map);
+    if (ret) {
+        dev_err(priv->dev, "Register restore failed: %d\n", ret);
+        return ret;
+    }
+    priv->sync_writes = priv->bus_writes - writes;
+    priv->sync_regs = priv->bus_regs - regs;
+
+    priv->context_saved = false;
+    return 0;
+}
+
+/*
+ * Quiesce I/O for the hibernation image; hardware stays powered. Holding
+ * io_sem for write drains pm_demo_do_io() callers, e.g. the stress
+ * harness, so none of them can touch the regmap while the image is taken.
+ * freeze and thaw may run on different async PM threads, so the lock is
+ * handed off to lockdep the way freeze_super() does for s_writers.
+ */
+static int pm_demo_quiesce(struct pm_demo_priv *priv)
+{
+    dev_dbg(priv->dev, "Quiescing for hibernation image\n");
+    down_write(&priv->io_sem);
+    rwsem_release(&priv->io_sem.dep_map, _THIS_IP_);
+    priv->io_quiesced = true;
     return 0;
 }
 
+static int pm_demo_unquiesce(struct pm_demo_priv *priv)
+{
+    if (!priv->io_quiesced)
+        return 0;
+
+    dev_dbg(priv->dev, "Restarting I/O after hibernation image\n");
+    priv->io_quiesced = false;
+    rwsem_acquire(&priv->io_sem.dep_map, 0, 1, _THIS_IP_);
+    up_write(&priv->io_sem);
+    return 0;
+}
+
+static int pm_demo_run_phase(struct device *dev, enum pm_demo_phase phase,
+                             int (*work)(struct pm_demo_priv *priv))
+{
+    struct pm_demo_priv *priv = dev_get_drvdata(dev);
+    ktime_t t0 = pm_demo_phase_begin(priv, phase);
+    int ret = work ? work(priv) : 0;
+
+    pm_demo_phase_end(priv, phase, t0);
+    return ret;
+}
+
+static int pm_demo_prepare(struct device *dev)
+{
+    /* block new I/O submission here in real drivers */
+    return pm_demo_run_phase(dev, PM_DEMO_PREPARE, NULL);
+}
+
+static void pm_demo_complete(struct device *dev)
+{
+    pm_demo_run_phase(dev, PM_DEMO_COMPLETE, NULL);
+}
+
+/* Suspend to RAM / idle */
+static int pm_demo_suspend(struct device *dev)
+{
+    return pm_demo_run_phase(dev, PM_DEMO_SUSPEND, pm_demo_save_context);
+}
+
+static int pm_demo_suspend_late(struct device *dev)
+{
+    return pm_demo_run_phase(dev, PM_DEMO_SUSPEND_LATE, NULL);
+}
+
+static int pm_demo_suspend_noirq(struct device *dev)
+{
+    /* arm wakeup sources here in real drivers */
+    return pm_demo_run_phase(dev, PM_DEMO_SUSPEND_NOIRQ, NULL);
+}
+
+static int pm_demo_resume_noirq(struct device *dev)
+{
+    return pm_demo_run_phase(dev, PM_DEMO_RESUME_NOIRQ, NULL);
+}
+
+static int pm_demo_resume_early(struct device *dev)
+{
+    return pm_demo_run_phase(dev, PM_DEMO_RESUME_EARLY, NULL);
+}
+
+static int pm_demo_resume(struct device *dev)
+{
+    return pm_demo_run_phase(dev, PM_DEMO_RESUME, pm_demo_restore_context);
+}
+
+/* Hibernation: image creation */
+static int pm_demo_freeze(struct device *dev)
+{
+    return pm_demo_run_phase(dev, PM_DEMO_FREEZE, pm_demo_quiesce);
+}
+
+static int pm_demo_freeze_late(struct device *dev)
+{
+    return pm_demo_run_phase(dev, PM_DEMO_FREEZE_LATE, NULL);
+}
+
+static int pm_demo_freeze_noirq(struct device *dev)
+{
+    return pm_demo_run_phase(dev, PM_DEMO_FREEZE_NOIRQ, NULL);
+}
+
+static int pm_demo_thaw_noirq(struct device *dev)
+{
+    return pm_demo_run_phase(dev, PM_DEMO_THAW_NOIRQ, NULL);
+}
+
+static int pm_demo_thaw_early(struct device *dev)
+{
+    return pm_demo_run_phase(dev, PM_DEMO_THAW_EARLY, NULL);
+}
+
+static int pm_demo_thaw(struct device *dev)
+{
+    return pm_demo_run_phase(dev, PM_DEMO_THAW, pm_demo_unquiesce);
+}
+
+/* Hibernation: power down after the image is written, and image restore */
+static int pm_demo_poweroff(struct device *dev)
+{
+    return pm_demo_run_phase(dev, PM_DEMO_POWEROFF, pm_demo_save_context);
+}
+
+static int pm_demo_poweroff_late(struct device *dev)
+{
+    return pm_demo_run_phase(dev, PM_DEMO_POWEROFF_LATE, NULL);
+}
+
+static int pm_demo_poweroff_noirq(struct device *dev)
+{
+    return pm_demo_run_phase(dev, PM_DEMO_POWEROFF_NOIRQ, NULL);
+}
+
+static int pm_demo_restore_noirq(struct device *dev)
+{
+    return pm_demo_run_phase(dev, PM_DEMO_RESTORE_NOIRQ, NULL);
+}
+
+static int pm_demo_restore_early(struct device *dev)
+{
+    return pm_demo_run_phase(dev, PM_DEMO_RESTORE_EARLY, NULL);
+}
+
+/*
+ * The restore kernel may have left the device in any state, so always
+ * treat the saved context as valid here.
+ */
+static int pm_demo_restore(struct device *dev)
+{
+    struct pm_demo_priv *priv = dev_get_drvdata(dev);
+    int ret;
+
+    priv->context_saved = true;
+    ret = pm_demo_run_phase(dev, PM_DEMO_RESTORE, pm_demo_restore_context);
+
+    /*
+     * The image was taken after freeze fenced off I/O and thaw never runs
+     * in the restored kernel, so drop the fence here.
+     */
+    pm_demo_unquiesce(priv);
+    return ret;
+}
+
+/* Runtime PM: same context handling, driven by autosuspend */
+static int pm_demo_runtime_suspend(struct device *dev)
+{
+    return pm_demo_run_phase(dev, PM_DEMO_RUNTIME_SUSPEND,
+                             pm_demo_save_context);
+}
+
+static int pm_demo_runtime_resume(struct device *dev)
+{
+    return pm_demo_run_phase(dev, PM_DEMO_RUNTIME_RESUME,
+                             pm_demo_restore_context);
+}
+
 static const struct dev_pm_ops pm_demo_ops = {
-    .suspend = pm_demo_suspend,
-    .resume  = pm_demo_resume,
+    .prepare        = pm_demo_prepare,
+    .complete       = pm_demo_complete,
+    .suspend        = pm_demo_suspend,
+    .suspend_late   = pm_demo_suspend_late,
+    .suspend_noirq  = pm_demo_suspend_noirq,
+    .resume_noirq   = pm_demo_resume_noirq,
+    .resume_early   = pm_demo_resume_early,
+    .resume         = pm_demo_resume,
+    .freeze         = pm_demo_freeze,
+    .freeze_late    = pm_demo_freeze_late,
+    .freeze_noirq   = pm_demo_freeze_noirq,
+    .thaw_noirq     = pm_demo_thaw_noirq,
+    .thaw_early     = pm_demo_thaw_early,
+    .thaw           = pm_demo_thaw,
+    .poweroff       = pm_demo_poweroff,
+    .poweroff_late  = pm_demo_poweroff_late,
+    .poweroff_noirq = pm_demo_poweroff_noirq,
+    .restore_noirq  = pm_demo_restore_noirq,
+    .restore_early  = pm_demo_restore_early,
+    .restore        = pm_demo_restore,
+    .runtime_suspend = pm_demo_runtime_suspend,
+    .runtime_resume  = pm_demo_runtime_resume,
 };
 
+/* -------- Stress Harness -------- */
+
+static int pm_demo_stress_io_thread(void *data)
+{
+    struct pm_demo_priv *priv = data;
+
+    while (!kthread_should_stop()) {
+        pm_demo_do_io(priv);
+        cond_resched();
+    }
+
+    return 0;
+}
+
+/*
+ * Walk our own dev_pm_ops in the order the PM core would for a suspend to
+ * RAM, including disabling runtime PM around the late/noirq phases. I/O is
+ * fenced off for the whole cycle, like the freezer would do.
+ */
+static int pm_demo_sim_system_cycle(struct pm_demo_priv *priv, u64 *resume_ns)
+{
+    struct device *dev = priv->dev;
+    ktime_t t0 = 0;
+    int ret;
+
+    down_write(&priv->io_sem);
+    pm_runtime_get_sync(dev);
+
+    ret = pm_demo_ops.prepare(dev);
+    if (ret)
+        goto out;
+    ret = pm_demo_ops.suspend(dev);
+    if (ret)
+        goto complete;
+    pm_runtime_disable(dev);
+    ret = pm_demo_ops.suspend_late(dev);
+    if (ret)
+        goto resume;
+    ret = pm_demo_ops.suspend_noirq(dev);
+    if (ret)
+        goto resume_early;
+
+    t0 = ktime_get();
+    pm_demo_ops.resume_noirq(dev);
+resume_early:
+    pm_demo_ops.resume_early(dev);
+resume:
+    pm_runtime_enable(dev);
+    pm_demo_ops.resume(dev);
+complete:
+    pm_demo_ops.complete(dev);
+    if (!ret)
+        *resume_ns = ktime_to_ns(ktime_sub(ktime_get(), t0));
+out:
+    pm_runtime_mark_last_busy(dev);
+    pm_runtime_put_autosuspend(dev);
+    up_write(&priv->io_sem);
+    return ret;
+}
+
+// Force a runtime suspend with I/O drained, then time the wake-up
+static int pm_demo_sim_runtime_cycle(struct pm_demo_priv *priv, u64 *resume_ns)
+{
+    struct device *dev = priv->dev;
+    ktime_t t0;
+    int ret;
+
+    down_write(&priv->io_sem);
+    ret = pm_runtime_suspend(dev);
+    up_write(&priv->io_sem);
+    if (ret < 0)
+        return ret;
+
+    t0 = ktime_get();
+    ret = pm_runtime_resume_and_get(dev);
+    if (ret)
+        return ret;
+    *resume_ns = ktime_to_ns(ktime_sub(ktime_get(), t0));
+
+    pm_runtime_mark_last_busy(dev);
+    pm_runtime_put_autosuspend(dev);
+    return 0;
+}
+
+static int pm_demo_cmp_u64(const void *a, const void *b)
+{
+    u64 x = *(const u64 *)a, y = *(const u64 *)b;
+
+    return x < y ? -1 : x > y;
+}
+
+// Per-mille percentile of an already sorted array
+static u64 pm_demo_pctl(const u64 *v, u32 n, u32 permille)
+{
+    return n ? v[div_u64((u64)(n - 1) * permille, 1000)] : 0;
+}
+
+/*
+ * Alternate runtime and simulated system PM cycles while @threads kthreads
+ * hammer the I/O path. Each cycle is one throughput window, so a cycle that
+ * stalls I/O for too long shows up as a dip.
+ */
+static int pm_demo_stress_run(struct pm_demo_priv *priv, u32 cycles, u32 threads)
+{
+    struct pm_demo_stress_report *r = &priv->report;
+    struct task_struct **tasks;
+    u64 *resume_ns, *tput;
+    u64 sum = 0, ops_prev;
+    ktime_t start, win_start;
+    u32 i, nres = 0;
+    int ret = 0;
+
+    tasks = kcalloc(threads, sizeof(*tasks), GFP_KERNEL);
+    resume_ns = kvmalloc_array(cycles, sizeof(*resume_ns), GFP_KERNEL);
+    tput = kvmalloc_array(cycles, sizeof(*tput), GFP_KERNEL);
+    if ((threads && !tasks) || !resume_ns || !tput) {
+        ret = -ENOMEM;
+        goto out_free;
+    }
+
+    memset(r, 0, sizeof(*r));
+    r->cycles = cycles;
+    r->threads = threads;
+    pm_demo_load_pause(priv, true);
+
+    for (i = 0; i < threads; i++) {
+        tasks[i] = kthread_run(pm_demo_stress_io_thread, priv,
+                               "pm_demo_io/%u", i);
+        if (IS_ERR(tasks[i])) {
+            ret = PTR_ERR(tasks[i]);
+            tasks[i] = NULL;
+            goto out_stop;
+        }
+    }
+
+    start = ktime_get();
+    ops_prev = atomic64_read(&priv->io_ops);
+    for (i = 0; i < cycles; i++) {
+        u64 ns = 0, ops, win_ns;
+        bool system = i & 1;
+
+        win_start = ktime_get();
+        ret = system ? pm_demo_sim_system_cycle(priv, &ns) :
+                       pm_demo_sim_runtime_cycle(priv, &ns);
+        if (ret == -EPERM) {
+            r->qos_blocked++;
+            ret = 0;
+        } else if (ret) {
+            r->failures++;
+            ret = 0;
+        } else {
+            resume_ns[nres++] = ns;
+            if (system)
+                r->system_cycles++;
+            else
+                r->runtime_cycles++;
+        }
+
+        /* Give the I/O threads a slice of the window outside the fence */
+        usleep_range(100, 200);
+
+        ops = atomic64_read(&priv->io_ops);
+        win_ns = ktime_to_ns(ktime_sub(ktime_get(), win_start));
+        tput[i] = win_ns ? div64_u64((ops - ops_prev) * NSEC_PER_SEC, win_ns) : 0;
+        sum += tput[i];
+        ops_prev = ops;
+
+        if (fatal_signal_pending(current)) {
+            r->cycles = i + 1;
+            break;
+        }
+    }
+    r->elapsed_ns = ktime_to_ns(ktime_sub(ktime_get(), start));
+
+out_stop:
+    for (i = 0; i < threads && tasks[i]; i++)
+        kthread_stop(tasks[i]);
+    pm_demo_load_pause(priv, false);
+    if (ret)
+        goto out_free;
+
+    r->io_ops = atomic64_read(&priv->io_ops);
+    if (r->cycles) {
+        r->tput_mean = div_u64(sum, r->cycles);
+        r->tput_min = U64_MAX;
+        for (i = 0; i < r->cycles; i++) {
+            r->tput_min = min(r->tput_min, tput[i]);
+            if (tput[i] * 100 < r->tput_mean * PM_DEMO_STRESS_DIP_PCT)
+                r->dips++;
+        }
+    }
+
+    sort(resume_ns, nres, sizeof(*resume_ns), pm_demo_cmp_u64, NULL);
+    r->resume_p50_ns = pm_demo_pctl(resume_ns, nres, 500);
+    r->resume_p99_ns = pm_demo_pctl(resume_ns, nres, 990);
+    r->resume_p999_ns = pm_demo_pctl(resume_ns, nres, 999);
+    r->resume_max_ns = nres ? resume_ns[nres - 1] : 0;
+
+out_free:
+    kvfree(tput);
+    kvfree(resume_ns);
+    kfree(tasks);
+    return ret;
+}
+
+static int pm_demo_stress_show(struct seq_file *s, void *unused)
+{
+    struct pm_demo_priv *priv = s->private;
+    struct pm_demo_stress_report *r = &priv->report;
+
+    mutex_lock(&priv->stress_lock);
+    seq_printf(s, "cycles:          %u (runtime %u, system %u, failed %u, qos_blocked %u)\n",
+               r->cycles, r->runtime_cycles, r->system_cycles, r->failures,
+               r->qos_blocked);
+    seq_printf(s, "io_threads:      %u\n", r->threads);
+    seq_printf(s, "elapsed_ms:      %llu\n", div_u64(r->elapsed_ns, NSEC_PER_MSEC));
+    seq_printf(s, "io_ops_total:    %llu\n", r->io_ops);
+    seq_printf(s, "tput_mean_ops_s: %llu\n", r->tput_mean);
+    seq_printf(s, "tput_min_ops_s:  %llu\n", r->tput_min);
+    seq_printf(s, "tput_dips:       %u (< %u%% of mean)\n",
+               r->dips, PM_DEMO_STRESS_DIP_PCT);
+    seq_printf(s, "resume_p50_us:   %llu\n", div_u64(r->resume_p50_ns, NSEC_PER_USEC));
+    seq_printf(s, "resume_p99_us:   %llu\n", div_u64(r->resume_p99_ns, NSEC_PER_USEC));
+    seq_printf(s, "resume_p999_us:  %llu\n", div_u64(r->resume_p999_ns, NSEC_PER_USEC));
+    seq_printf(s, "resume_max_us:   %llu\n", div_u64(r->resume_max_ns, NSEC_PER_USEC));
+    mutex_unlock(&priv->stress_lock);
+
+    return 0;
+}
+
+static int pm_demo_stress_open(struct inode *inode, struct file *file)
+{
+    return single_open(file, pm_demo_stress_show, inode->i_private);
+}
+
+// "<cycles> <io_threads>" - runs synchronously, then read back the report
+static ssize_t pm_demo_stress_write(struct file *file, const char __user *ubuf,
+                                    size_t count, loff_t *ppos)
+{
+    struct pm_demo_priv *priv = ((struct seq_file *)file->private_data)->private;
+    unsigned int cycles, threads;
+    char buf[32];
+    int ret;
+
+    if (count >= sizeof(buf))
+        return -EINVAL;
+    if (copy_from_user(buf, ubuf, count))
+        return -EFAULT;
+    buf[count] = '\0';
+
+    if (sscanf(buf, "%u %u", &cycles, &threads) != 2)
+        return -EINVAL;
+    if (!cycles || cycles > PM_DEMO_STRESS_MAX_CYCLES ||
+        threads > PM_DEMO_STRESS_MAX_THREADS)
+        return -EINVAL;
+
+    if (!mutex_trylock(&priv->stress_lock))
+        return -EBUSY;
+    ret = pm_demo_stress_run(priv, cycles, threads);
+    mutex_unlock(&priv->stress_lock);
+
+    dev_info(priv->dev, "Stress run of %u cycles finished: %d\n", cycles, ret);
+    return ret ? ret : count;
+}
+
+static const struct file_operations pm_demo_stress_fops = {
+    .owner   = THIS_MODULE,
+    .open    = pm_demo_stress_open,
+    .read    = seq_read,
+    .write   = pm_demo_stress_write,
+    .llseek  = seq_lseek,
+    .release = single_release,
+};
+
+static int pm_demo_probe(struct platform_device *pdev)
+{
+    struct pm_demo_priv *priv;
+    int ret;
+
+    priv = devm_kzalloc(&pdev->dev, sizeof(*priv), GFP_KERNEL);
+    if (!priv)
+        return -ENOMEM;
+
+    priv->dev = &pdev->dev;
+    spin_lock_init(&priv->stats_lock);
+    init_rwsem(&priv->io_sem);
+    mutex_init(&priv->stress_lock);
+    pm_demo_stats_reset(priv);
+    platform_set_drvdata(pdev, priv);
+
+    ret = pm_demo_regs_init(priv);
+    if (ret) {
+        dev_err(&pdev->dev, "Failed to init register map: %d\n", ret);
+        return ret;
+    }
+
+    /*
+     * Let the PM core run our suspend/resume in parallel with unrelated
+     * devices instead of in the serialized dpm_list walk.
+     */
+    device_enable_async_suspend(&pdev->dev);
+
+    pm_runtime_set_autosuspend_delay(&pdev->dev, PM_DEMO_AUTOSUSPEND_MS);
+    pm_runtime_use_autosuspend(&pdev->dev);
+    pm_runtime_set_active(&pdev->dev);
+    ret = devm_pm_runtime_enable(&pdev->dev);
+    if (ret)
+        return ret;
+
+    ret = pm_demo_load_init(priv);
+    if (ret) {
+        dev_err(&pdev->dev, "Failed to add PM QoS request: %d\n", ret);
+        return ret;
+    }
+
+    priv->debugfs_dir = debugfs_create_dir(dev_name(&pdev->dev),
+                                           pm_demo_debugfs_root);
+    debugfs_create_file("latency", 0444, priv->debugfs_dir, priv,
+                        &pm_demo_latency_fops);
+    debugfs_create_file("regcache", 0444, priv->debugfs_dir, priv,
+                        &pm_demo_regcache_fops);
+    debugfs_create_file("reg_poke", 0200, priv->debugfs_dir, priv,
+                        &pm_demo_reg_poke_fops);
+    debugfs_create_file("stress", 0600, priv->debugfs_dir, priv,
+                        &pm_demo_stress_fops);
+
+    dev_info(&pdev->dev, "PM Demo Driver Probed\n");
+    return 0;
+}
+
+static int pm_demo_remove(struct platform_device *pdev)
+{
+    struct pm_demo_priv *priv = platform_get_drvdata(pdev);
+
+    debugfs_remove_recursive(priv->debugfs_dir);
+    pm_demo_load_exit(priv);
+    dev_info(&pdev->dev, "PM Demo Driver Removed\n");
+    return 0;
+}
+
 /* -------- Device Tree Match Table -------- */
 static const struct of_device_id pm_demo_of_match[] = {
     { .compatible = "demo,pm-hooks" },
@@ -53,10 +1490,64 @@ static struct platform_driver pm_demo_driver = {
         .name = DRIVER_NAME,
         .of_match_table = pm_demo_of_match,
         .pm = &pm_demo_ops,  // <-- attaching PM hooks here
+        .dev_groups = pm_demo_groups,
     },
 };
 
-module_platform_driver(pm_demo_driver);
+static void pm_demo_sim_unregister(void)
+{
+    int i;
+
+    for (i = 0; i < PM_DEMO_MAX_SIM_DEVICES; i++) {
+        if (pm_demo_sim_pdev[i])
+            platform_device_unregister(pm_demo_sim_pdev[i]);
+        pm_demo_sim_pdev[i] = NULL;
+    }
+}
+
+static int __init pm_demo_init(void)
+{
+    unsigned int i;
+    int ret;
+
+    pm_demo_debugfs_root = debugfs_create_dir(DRIVER_NAME, NULL);
+
+    ret = platform_driver_register(&pm_demo_driver);
+    if (ret)
+        goto err_debugfs;
+
+    // Create simulated devices so the driver can be exercised without DT
+    for (i = 0; i < min_t(unsigned int, sim_devices, PM_DEMO_MAX_SIM_DEVICES); i++) {
+        pm_demo_sim_pdev[i] = platform_device_register_simple(DRIVER_NAME, i,
+                                                              NULL, 0);
+        if (IS_ERR(pm_demo_sim_pdev[i])) {
+            ret = PTR_ERR(pm_demo_sim_pdev[i]);
+            pm_demo_sim_pdev[i] = NULL;
+            pr_err("%s: Failed to register simulated device %u\n",
+                   DRIVER_NAME, i);
+            goto err_sim;
+        }
+    }
+
+    return 0;
+
+err_sim:
+    pm_demo_sim_unregister();
+    platform_driver_unregister(&pm_demo_driver);
+err_debugfs:
+    debugfs_remove_recursive(pm_demo_debugfs_root);
+    return ret;
+}
+
+static void __exit pm_demo_exit(void)
+{
+    pm_demo_sim_unregister();
+    platform_driver_unregister(&pm_demo_driver);
+    debugfs_remove_recursive(pm_demo_debugfs_root);
+}
+
+module_init(pm_demo_init);
+module_exit(pm_demo_exit);
 
 MODULE_LICENSE("GPL");
 MODULE_AUTHOR("Satya Prakash Rout");
@@ -0,0 +1,48 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+#undef TRACE_SYSTEM
+#define TRACE_SYSTEM pm_hooks_demo
+
+#if !defined(_PM_HOOKS_TRACE_H) || defined(TRACE_HEADER_MULTI_READ)
+#define _PM_HOOKS_TRACE_H
+
+#include <linux/device.h>
+#include <linux/tracepoint.h>
+
+/*
+ * One event per PM phase boundary: fired with enter=1 when a callback
+ * starts and enter=0 (plus the measured duration) when it returns.
+ */
+TRACE_EVENT(pm_demo_phase,
+
+    TP_PROTO(struct device *dev, const char *phase, bool enter, u64 delta_ns),
+
+    TP_ARGS(dev, phase, enter, delta_ns),
+
+    TP_STRUCT__entry(
+        __string(dev_name, dev_name(dev))
+        __string(phase, phase)
+        __field(bool, enter)
+        __field(u64, delta_ns)
+    ),
+
+    TP_fast_assign(
+        __assign_str(dev_name, dev_name(dev));
+        __assign_str(phase, phase);
+        __entry->enter = enter;
+        __entry->delta_ns = delta_ns;
+    ),
+
+    TP_printk("dev=%s phase=%s %s delta_ns=%llu",
+              __get_str(dev_name), __get_str(phase),
+              __entry->enter ? "enter" : "exit",
+              (unsigned long long)__entry->delta_ns)
+);
+
+#endif /* _PM_HOOKS_TRACE_H */
+
+/* This part must be outside protection */
+#undef TRACE_INCLUDE_PATH
+#define TRACE_INCLUDE_PATH .
+#undef TRACE_INCLUDE_FILE
+#define TRACE_INCLUDE_FILE pm_hooks_trace
+#include <trace/define_trace.h>